@@ -0,0 +1,125 @@
+#include "structs/structs.hpp"
+
+#include "vkr/vkr.hpp"
+#include "ecs/ecs.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Compares the per-frame HasComponent/GetComponent pattern used by vkr::Renderer::Render against the old
+// lookup path, which scanned a vector<shared_ptr<Component>> with typeid and then dynamic_pointer_cast.
+
+namespace legacy {
+    class Entity {
+        public:
+        std::vector<std::shared_ptr<ecs::Component>> components;
+
+        template <class T, typename... Args>
+        T& AddComponent(Args&&... args) {
+            auto component = std::make_shared<T>(std::forward<Args>(args)...);
+            components.push_back(component);
+            return *component;
+        }
+
+        template <class T>
+        T& GetComponent() {
+            for (size_t i = 0; i < components.size(); i++) {
+                auto& kv = components.at(i);
+                if (typeid(*kv) == typeid(T)) {
+                    return *std::dynamic_pointer_cast<T>(kv);
+                }
+            }
+            throw std::runtime_error("Could not find component in entity.");
+        }
+
+        template <class T>
+        bool HasComponent() {
+            for (size_t i = 0; i < components.size(); i++) {
+                if (typeid(*components.at(i)) == typeid(T)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+}
+
+constexpr size_t ENTITY_COUNT = 100000;
+constexpr int ITERATIONS = 50;
+
+template <class E>
+E& Deref(E& entity) {
+    return entity;
+}
+
+template <class E>
+E& Deref(E* entity) {
+    return *entity;
+}
+
+template <class E>
+float Lookup(std::vector<E>& entities) {
+    float sum = 0;
+    for (auto& e : entities) {
+        auto& entity = Deref(e);
+        if (entity.template HasComponent<ecs::Mesh2D>()) {
+            sum += entity.template GetComponent<ecs::Transform2D>().rotation;
+        }
+        else if (entity.template HasComponent<ecs::Mesh3D>()) {
+            sum += entity.template GetComponent<ecs::Transform3D>().position[0];
+        }
+    }
+    return sum;
+}
+
+template <class E>
+void Run(const char* name, std::vector<E>& entities) {
+    volatile float sink = Lookup(entities);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        sink = sink + Lookup(entities);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / (double(ITERATIONS) * entities.size());
+    std::cout << name << ": " << ns << " ns per entity" << std::endl;
+}
+
+int main() {
+    std::vector<std::unique_ptr<legacy::Entity>> legacyStorage;
+    std::vector<legacy::Entity*> legacyEntities;
+    ecs::EntityManager em;
+    std::vector<ecs::Entity> entities;
+
+    for (size_t i = 0; i < ENTITY_COUNT; i++) {
+        legacyStorage.push_back(std::make_unique<legacy::Entity>());
+        auto& l = *legacyStorage.back();
+        auto e = em.AddEntity();
+
+        l.AddComponent<ecs::RigidBody3D>();
+        e.AddComponent<ecs::RigidBody3D>();
+        if (i % 2) {
+            l.AddComponent<ecs::Transform2D>().rotation = float(i);
+            l.AddComponent<ecs::Mesh2D>(nullptr);
+            e.AddComponent<ecs::Transform2D>().rotation = float(i);
+            e.AddComponent<ecs::Mesh2D>(nullptr);
+        }
+        else {
+            l.AddComponent<ecs::Transform3D>().position[0] = float(i);
+            l.AddComponent<ecs::Mesh3D>(nullptr);
+            e.AddComponent<ecs::Transform3D>().position[0] = float(i);
+            e.AddComponent<ecs::Mesh3D>(nullptr);
+        }
+
+        legacyEntities.push_back(&l);
+        entities.push_back(e);
+    }
+
+    Run("typeid scan + dynamic_pointer_cast", legacyEntities);
+    Run("signature bit test + column index", entities);
+
+    return 0;
+}
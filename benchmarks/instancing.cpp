@@ -0,0 +1,63 @@
+#include "structs/structs.hpp"
+
+#include "vkr/vkr.hpp"
+#include "ecs/ecs.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Batches 100k transformed entities over a handful of meshes the way VulkanRendering::ExtractSnapshot does, and
+// reports the draws recorded per frame with and without instancing. The device currently needs a window surface,
+// so this runs without one and measures the CPU side: building the instance data every frame is what instancing
+// adds, the per-entity draw path it replaces cost one vkCmdDrawIndexed per entity.
+
+constexpr size_t ENTITY_COUNT = 100000;
+constexpr uint32_t MESH_COUNT = 16;
+constexpr int ITERATIONS = 50;
+
+// Stands in for ecs::Mesh3D, which needs a mesh living on the device.
+class BenchmarkMesh : public ecs::Component {
+    public:
+    BenchmarkMesh(uint32_t i) : id{i} {}
+    uint32_t id;
+};
+
+int main() {
+    ecs::EntityManager em;
+    for (size_t i = 0; i < ENTITY_COUNT; i++) {
+        auto entity = em.AddEntity();
+        auto& transform = entity.AddComponent<ecs::Transform3D>();
+        transform.position = {float(i % 100), float(i / 100 % 100), float(i / 10000)};
+        transform.rotation = {0.01f * float(i), 0.02f * float(i), 0.03f * float(i)};
+        entity.AddComponent<BenchmarkMesh>(static_cast<uint32_t>(i % MESH_COUNT));
+    }
+
+    int meshes[MESH_COUNT];
+    vkr::InstanceBatcher batcher;
+    std::vector<InstanceData> instances;
+    auto view = em.View<const ecs::Transform3D, const BenchmarkMesh>();
+    const qbn::vec<float, 4> colour{1, 1, 1, 1};
+
+    auto extract = [&]() {
+        instances.clear();
+        batcher.Clear();
+        view.Each([&](const ecs::Transform3D& transform, const BenchmarkMesh& mesh) {
+            batcher.Add(&meshes[mesh.id], {transform.GetModelMatrix(), colour});
+        });
+        return batcher.Build(instances).size();
+    };
+
+    size_t draws = extract();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        draws = extract();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / ITERATIONS;
+
+    printf("%zu entities over %u meshes\n", ENTITY_COUNT, MESH_COUNT);
+    printf("draws per frame: %zu per entity, %zu instanced\n", ENTITY_COUNT, draws);
+    printf("instance data per frame: %.2f MiB\n", double(instances.size() * sizeof(InstanceData)) / (1024.0 * 1024.0));
+    printf("extraction and batching: %.3f ms\n", milliseconds);
+}
@@ -0,0 +1,64 @@
+#include "structs/structs.hpp"
+
+#include "vkr/vkr.hpp"
+#include "ecs/ecs.hpp"
+#include "thm/parallel_for.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+// Measures how a per-entity transform update scales with the number of job system workers. The update is run
+// through thm::ParallelForEach, so every worker count uses the same chunk batching.
+
+constexpr size_t ENTITY_COUNT = 1000000;
+constexpr int ITERATIONS = 20;
+
+void UpdateTransform(ecs::Transform3D& transform, float dt) {
+    for (int i = 0; i < 3; i++) {
+        transform.rotation[i] = std::fmod(transform.rotation[i] + dt * (i + 1), 6.2831853f);
+        transform.position[i] += std::sin(transform.rotation[i]) * transform.scale[i] * dt;
+    }
+}
+
+double Run(thm::JobSystem& jobs, ecs::EntityManager& em) {
+    auto view = em.View<ecs::Transform3D>();
+    auto update = [](ecs::Transform3D& transform) { UpdateTransform(transform, 0.016f); };
+    thm::ParallelForEach(jobs, view, update);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        thm::ParallelForEach(jobs, view, update);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / ITERATIONS;
+}
+
+int main() {
+    ecs::EntityManager em;
+    for (size_t i = 0; i < ENTITY_COUNT; i++) {
+        auto e = em.AddEntity();
+        e.AddComponent<ecs::Transform3D>().position[0] = float(i);
+    }
+
+    // The thread calling ParallelFor also runs batches, so n workers keep up to n + 1 cores busy.
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double baseline = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+        double ms;
+        {
+            thm::JobSystem jobs(threads);
+            ms = Run(jobs, em);
+        }
+        if (threads == 1) {
+            baseline = ms;
+        }
+        double throughput = ENTITY_COUNT / ms / 1000.0;
+        std::cout << threads << " workers: " << ms << " ms per update, " << throughput << " M entities/s, "
+                  << baseline / ms << "x" << std::endl;
+    }
+
+    return 0;
+}
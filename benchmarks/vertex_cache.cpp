@@ -0,0 +1,87 @@
+#include "structs/structs.hpp"
+
+#include "vkr/rendering/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+// Counts vertex shader invocations for a UV sphere drawn as a triangle soup, as an indexed mesh in its authored
+// order, as an indexed mesh with shuffled triangles (what most exporters hand over) and after the passes
+// vkr::Mesh runs at creation. Invocations come from a simulated 16 entry FIFO post-transform cache.
+
+constexpr int RINGS = 256;
+constexpr int SEGMENTS = 512;
+constexpr uint32_t CACHE_SIZE = 16;
+
+Vertex3D SphereVertex(int ring, int segment) {
+    float theta = 3.14159265f * float(ring) / float(RINGS);
+    float phi = 6.2831853f * float(segment % SEGMENTS) / float(SEGMENTS);
+    float x = std::sin(theta) * std::cos(phi);
+    float y = std::cos(theta);
+    float z = std::sin(theta) * std::sin(phi);
+    return {{x, y, z}, {x, y, z}, {1, 1, 1, 1}, {float(segment) / float(SEGMENTS), float(ring) / float(RINGS)}};
+}
+
+std::vector<Vertex3D> MakeSphereSoup() {
+    std::vector<Vertex3D> soup;
+    for (int r = 0; r < RINGS; r++) {
+        for (int s = 0; s < SEGMENTS; s++) {
+            Vertex3D a = SphereVertex(r, s), b = SphereVertex(r + 1, s), c = SphereVertex(r + 1, s + 1), d = SphereVertex(r, s + 1);
+            soup.insert(soup.end(), {a, b, c, a, c, d});
+        }
+    }
+    return soup;
+}
+
+void Report(const char* name, const vkr::VertexCacheStats& stats) {
+    printf("%-28s %12u %8.3f %8.3f\n", name, stats.vertexShaderInvocations, stats.acmr, stats.atvr);
+}
+
+int main() {
+    std::vector<Vertex3D> vertices = MakeSphereSoup();
+    const size_t triangleCount = vertices.size() / 3;
+
+    printf("%zu triangles, %u entry FIFO cache\n", triangleCount, CACHE_SIZE);
+    printf("%-28s %12s %8s %8s\n", "", "VS calls", "ACMR", "ATVR");
+
+    // Without indices every corner is shaded, nothing can be reused.
+    vkr::VertexCacheStats soup;
+    soup.vertexShaderInvocations = static_cast<uint32_t>(vertices.size());
+    soup.acmr = 3.0f;
+
+    std::vector<uint32_t> indices = vkr::GenerateIndices(vertices);
+    soup.atvr = float(soup.vertexShaderInvocations) / float(vertices.size());
+    Report("non-indexed", soup);
+    Report("indexed, authored order", vkr::AnalyzeVertexCache(indices, vertices.size(), CACHE_SIZE));
+
+    std::vector<uint32_t> shuffled(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        shuffled[t] = static_cast<uint32_t>(t);
+    }
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+    std::vector<uint32_t> scrambled;
+    scrambled.reserve(indices.size());
+    for (uint32_t t : shuffled) {
+        scrambled.insert(scrambled.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+    }
+    Report("indexed, shuffled", vkr::AnalyzeVertexCache(scrambled, vertices.size(), CACHE_SIZE));
+
+    auto start = std::chrono::high_resolution_clock::now();
+    vkr::OptimizeVertexCache(scrambled, vertices.size());
+    auto cacheEnd = std::chrono::high_resolution_clock::now();
+    Report("vertex cache optimised", vkr::AnalyzeVertexCache(scrambled, vertices.size(), CACHE_SIZE));
+
+    vkr::OptimizeOverdraw(scrambled, vertices, CACHE_SIZE);
+    auto overdrawEnd = std::chrono::high_resolution_clock::now();
+    Report("+ overdraw optimised", vkr::AnalyzeVertexCache(scrambled, vertices.size(), CACHE_SIZE));
+
+    vkr::OptimizeVertexFetch(scrambled, vertices);
+    Report("+ vertex fetch optimised", vkr::AnalyzeVertexCache(scrambled, vertices.size(), CACHE_SIZE));
+
+    printf("vertex cache pass %.2f ms, overdraw pass %.2f ms\n",
+        std::chrono::duration<double, std::milli>(cacheEnd - start).count(),
+        std::chrono::duration<double, std::milli>(overdrawEnd - cacheEnd).count());
+}
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "components/components.hpp"
+#include "component_id.hpp"
+#include "entity_handle.hpp"
+
+// std
+#include <vector>
+#include <memory>
+#include <array>
+#include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace ecs {
+    // Everything a chunk needs to know to move and destroy a component it does not know the type of.
+    struct ComponentInfo {
+        ComponentID id;
+        size_t size;
+        size_t alignment;
+        void (*MoveConstruct)(void* dst, void* src);
+        void (*Destroy)(void* ptr);
+
+        template <class T>
+        static ComponentInfo Of() {
+            return {
+                GetComponentID<T>(), sizeof(T), alignof(T),
+                [](void* dst, void* src) { new (dst) T(std::move(*static_cast<T*>(src))); },
+                [](void* ptr) { static_cast<T*>(ptr)->~T(); }
+            };
+        }
+    };
+
+    // Where an entity's components live inside its archetype.
+    struct EntityLocation {
+        uint32_t chunk = 0;
+        uint32_t row = 0;
+    };
+
+    // All entities with exactly the same set of components. Components are stored structure-of-arrays inside
+    // fixed-size chunks, so every column of a chunk is one contiguous array. Rows are kept dense by moving the
+    // last row into any hole, which means only the last chunk is ever partially filled.
+    class Archetype {
+        public:
+        static constexpr size_t CHUNK_SIZE = 16 * 1024;
+        static constexpr size_t CHUNK_ALIGNMENT = 64;
+        static constexpr uint32_t INVALID_ENTITY = std::numeric_limits<uint32_t>::max();
+
+        struct Chunk {
+            std::byte* data = nullptr;
+            uint32_t count = 0;
+        };
+
+        Archetype(std::vector<ComponentInfo> c) : components{std::move(c)} {
+            columns.fill(-1);
+            for (size_t i = 0; i < components.size(); i++) {
+                if (components[i].alignment > CHUNK_ALIGNMENT) {
+                    throw std::runtime_error("Component alignment is larger than the chunk alignment.");
+                }
+                columns[components[i].id] = static_cast<int16_t>(i);
+                signature.set(components[i].id);
+            }
+            CalculateLayout();
+        }
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+
+        ~Archetype() {
+            for (auto& chunk : chunks) {
+                for (uint32_t row = 0; row < chunk.count; row++) {
+                    for (size_t c = 0; c < components.size(); c++) {
+                        components[c].Destroy(chunk.data + offsets[c] + row * components[c].size);
+                    }
+                }
+                ::operator delete(chunk.data, std::align_val_t{CHUNK_ALIGNMENT});
+            }
+        }
+
+        bool Has(ComponentID id) const {
+            return signature.test(id);
+        }
+
+        int ColumnIndex(ComponentID id) const {
+            return columns[id];
+        }
+
+        const Signature& GetSignature() const {
+            return signature;
+        }
+
+        // Reserves a row at the end of the archetype. The component memory is left uninitialised.
+        EntityLocation Allocate(uint32_t entity) {
+            if (chunks.empty() || chunks.back().count == capacity) {
+                Chunk chunk;
+                chunk.data = static_cast<std::byte*>(::operator new(chunkBytes, std::align_val_t{CHUNK_ALIGNMENT}));
+                chunks.push_back(chunk);
+            }
+            auto& chunk = chunks.back();
+            EntityLocation location{static_cast<uint32_t>(chunks.size() - 1), chunk.count++};
+            Entities(location.chunk)[location.row] = entity;
+            return location;
+        }
+
+        // Gives back the last row without destroying its components, used when constructing into it failed.
+        void Deallocate() {
+            chunks.back().count--;
+            ReleaseEmptyChunk();
+        }
+
+        // Destroys the row at location and fills the hole with the last row. Returns the entity that was moved
+        // into location, or INVALID_ENTITY if the removed row was the last one.
+        uint32_t Remove(EntityLocation location) {
+            for (size_t c = 0; c < components.size(); c++) {
+                components[c].Destroy(Get(c, location));
+            }
+            return FillHole(location);
+        }
+
+        void* Get(size_t column, EntityLocation location) {
+            return chunks[location.chunk].data + offsets[column] + location.row * components[column].size;
+        }
+
+        template <class T>
+        T* Column(size_t chunk) {
+            return reinterpret_cast<T*>(chunks[chunk].data + offsets[columns[GetComponentID<T>()]]);
+        }
+
+        uint32_t* Entities(size_t chunk) {
+            return reinterpret_cast<uint32_t*>(chunks[chunk].data + entityOffset);
+        }
+
+        const std::vector<ComponentInfo>& GetComponents() const {
+            return components;
+        }
+
+        std::vector<Chunk>& GetChunks() {
+            return chunks;
+        }
+
+        uint32_t GetCapacity() const {
+            return capacity;
+        }
+
+        size_t Size() const {
+            return chunks.empty() ? 0 : (chunks.size() - 1) * capacity + chunks.back().count;
+        }
+
+        // Cached neighbours so adding or removing the same component again does not have to search for the target.
+        std::array<Archetype*, MAX_COMPONENTS> addEdges{};
+        std::array<Archetype*, MAX_COMPONENTS> removeEdges{};
+
+        private:
+        std::vector<ComponentInfo> components;
+        Signature signature;
+
+        // Component id to column index, -1 when the archetype does not have the component.
+        std::array<int16_t, MAX_COMPONENTS> columns;
+
+        std::vector<size_t> offsets;
+        size_t entityOffset = 0;
+        size_t chunkBytes = CHUNK_SIZE;
+        uint32_t capacity = 0;
+
+        std::vector<Chunk> chunks;
+
+        static size_t AlignUp(size_t value, size_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        size_t LayoutSize(uint32_t rows) {
+            size_t offset = 0;
+            offsets.resize(components.size());
+            for (size_t c = 0; c < components.size(); c++) {
+                offset = AlignUp(offset, components[c].alignment);
+                offsets[c] = offset;
+                offset += components[c].size * rows;
+            }
+            offset = AlignUp(offset, alignof(uint32_t));
+            entityOffset = offset;
+            return offset + sizeof(uint32_t) * rows;
+        }
+
+        void CalculateLayout() {
+            size_t rowSize = sizeof(uint32_t);
+            for (auto& component : components) {
+                rowSize += component.size;
+            }
+
+            capacity = static_cast<uint32_t>(std::max<size_t>(CHUNK_SIZE / rowSize, 1));
+            while (capacity > 1 && LayoutSize(capacity) > CHUNK_SIZE) {
+                capacity--;
+            }
+            chunkBytes = AlignUp(std::max(LayoutSize(capacity), CHUNK_SIZE), CHUNK_ALIGNMENT);
+        }
+
+        uint32_t FillHole(EntityLocation location) {
+            auto& last = chunks.back();
+            EntityLocation lastLocation{static_cast<uint32_t>(chunks.size() - 1), last.count - 1};
+            uint32_t moved = INVALID_ENTITY;
+
+            if (lastLocation.chunk != location.chunk || lastLocation.row != location.row) {
+                for (size_t c = 0; c < components.size(); c++) {
+                    components[c].MoveConstruct(Get(c, location), Get(c, lastLocation));
+                    components[c].Destroy(Get(c, lastLocation));
+                }
+                moved = Entities(lastLocation.chunk)[lastLocation.row];
+                Entities(location.chunk)[location.row] = moved;
+            }
+
+            last.count--;
+            ReleaseEmptyChunk();
+            return moved;
+        }
+
+        void ReleaseEmptyChunk() {
+            // Keep one empty chunk around so an entity bouncing between two archetypes does not reallocate.
+            if (chunks.size() > 1 && chunks.back().count == 0) {
+                ::operator delete(chunks.back().data, std::align_val_t{CHUNK_ALIGNMENT});
+                chunks.pop_back();
+            }
+        }
+    };
+
+    // Owns every archetype and maps entity handles to the row that holds their components. Freed entity slots
+    // are recycled through a free list, with the slot's generation bumped so stale handles can be rejected.
+    class ArchetypeStorage {
+        public:
+        ArchetypeStorage() {
+            root = GetArchetype({});
+        }
+
+        EntityHandle CreateEntity() {
+            uint32_t index;
+            if (!freeIndices.empty()) {
+                index = freeIndices.back();
+                freeIndices.pop_back();
+            }
+            else {
+                index = static_cast<uint32_t>(records.size());
+                records.emplace_back();
+            }
+
+            auto& record = records[index];
+            record.archetype = root;
+            record.location = root->Allocate(index);
+            record.signature.reset();
+            return {index, record.generation};
+        }
+
+        void DestroyEntity(EntityHandle handle) {
+            auto& record = GetRecord(handle);
+            Relocate(record.archetype->Remove(record.location), record.location);
+            record.archetype = nullptr;
+            record.signature.reset();
+            record.generation++;
+            freeIndices.push_back(handle.index);
+        }
+
+        bool IsAlive(EntityHandle handle) const {
+            return handle.index < records.size() && records[handle.index].generation == handle.generation && records[handle.index].archetype;
+        }
+
+        template <class T, typename... Args>
+        T& Add(EntityHandle handle, Args&&... args) {
+            const ComponentID type = GetComponentID<T>();
+            auto* source = GetRecord(handle).archetype;
+            if (source->Has(type)) {
+                throw std::runtime_error("Cannot add a second copy of the same component to entity.");
+            }
+
+            auto*& edge = source->addEdges[type];
+            if (!edge) {
+                auto components = source->GetComponents();
+                components.push_back(ComponentInfo::Of<T>());
+                edge = GetArchetype(std::move(components));
+                edge->removeEdges[type] = source;
+            }
+            auto* target = edge;
+
+            auto location = target->Allocate(handle.index);
+            T* component = static_cast<T*>(target->Get(target->ColumnIndex(type), location));
+            try {
+                new (component) T(std::forward<Args>(args)...);
+            }
+            catch (...) {
+                target->Deallocate();
+                throw;
+            }
+
+            MoveRow(handle.index, target, location);
+            return *component;
+        }
+
+        template <class T>
+        void Remove(EntityHandle handle) {
+            const ComponentID type = GetComponentID<T>();
+            auto* source = GetRecord(handle).archetype;
+            if (!source->Has(type)) {
+                throw std::runtime_error("Could not find component in entity.");
+            }
+
+            auto*& edge = source->removeEdges[type];
+            if (!edge) {
+                auto components = source->GetComponents();
+                components.erase(std::remove_if(components.begin(), components.end(), [type](const ComponentInfo& c) { return c.id == type; }), components.end());
+                edge = GetArchetype(std::move(components));
+                edge->addEdges[type] = source;
+            }
+
+            MoveRow(handle.index, edge, edge->Allocate(handle.index));
+        }
+
+        template <class T>
+        T& Get(EntityHandle handle) {
+            auto& record = GetRecord(handle);
+            int column = record.archetype->ColumnIndex(GetComponentID<T>());
+            if (column < 0) {
+                throw std::runtime_error("Could not find component in entity.");
+            }
+            return *static_cast<T*>(record.archetype->Get(column, record.location));
+        }
+
+        template <class T>
+        bool Has(EntityHandle handle) {
+            return GetRecord(handle).signature.test(GetComponentID<T>());
+        }
+
+        const Signature& GetSignature(EntityHandle handle) {
+            return GetRecord(handle).signature;
+        }
+
+        // Chunks only store the slot index of each row, this turns it back into a full handle.
+        EntityHandle GetHandle(uint32_t index) const {
+            return {index, records[index].generation};
+        }
+
+        // The archetypes that have at least the required components. Each query is matched against every
+        // archetype once when it is first asked for, after that new archetypes are appended as they are created,
+        // so iterating a query never has to look at archetypes that cannot match.
+        struct Query {
+            Signature required;
+            std::vector<Archetype*> archetypes;
+        };
+
+        // Safe to call from systems running in parallel, as long as no archetypes are being created meanwhile.
+        Query& GetQuery(const Signature& required) {
+            std::lock_guard<std::mutex> lock(queryMutex);
+            auto& query = queries[required];
+            if (!query) {
+                query = std::make_unique<Query>();
+                query->required = required;
+                for (auto& pair : archetypes) {
+                    if ((pair.first & required) == required) {
+                        query->archetypes.push_back(pair.second.get());
+                    }
+                }
+            }
+            return *query;
+        }
+
+        private:
+        struct EntityRecord {
+            Archetype* archetype = nullptr;
+            EntityLocation location;
+            Signature signature;
+            uint32_t generation = 0;
+        };
+
+        std::unordered_map<Signature, std::unique_ptr<Archetype>> archetypes;
+        std::unordered_map<Signature, std::unique_ptr<Query>> queries;
+        std::mutex queryMutex;
+        std::vector<EntityRecord> records;
+        std::vector<uint32_t> freeIndices;
+        Archetype* root = nullptr;
+
+        EntityRecord& GetRecord(EntityHandle handle) {
+            if (!IsAlive(handle)) {
+                throw std::runtime_error("Entity handle does not refer to a live entity.");
+            }
+            return records[handle.index];
+        }
+
+        Archetype* GetArchetype(std::vector<ComponentInfo> components) {
+            std::sort(components.begin(), components.end(), [](const ComponentInfo& a, const ComponentInfo& b) { return a.id < b.id; });
+
+            Signature key;
+            for (auto& component : components) {
+                key.set(component.id);
+            }
+
+            auto& archetype = archetypes[key];
+            if (!archetype) {
+                archetype = std::make_unique<Archetype>(std::move(components));
+                for (auto& pair : queries) {
+                    if ((key & pair.first) == pair.first) {
+                        pair.second->archetypes.push_back(archetype.get());
+                    }
+                }
+            }
+            return archetype.get();
+        }
+
+        // Moves every component the entity keeps from its current row into the freshly allocated row in target,
+        // then closes the gap it left behind.
+        void MoveRow(uint32_t index, Archetype* target, EntityLocation location) {
+            auto& record = records[index];
+            auto* source = record.archetype;
+
+            auto& components = source->GetComponents();
+            for (size_t c = 0; c < components.size(); c++) {
+                int column = target->ColumnIndex(components[c].id);
+                if (column >= 0) {
+                    components[c].MoveConstruct(target->Get(column, location), source->Get(c, record.location));
+                }
+            }
+
+            auto oldLocation = record.location;
+            record.archetype = target;
+            record.location = location;
+            record.signature = target->GetSignature();
+            Relocate(source->Remove(oldLocation), oldLocation);
+        }
+
+        void Relocate(uint32_t moved, EntityLocation location) {
+            if (moved != Archetype::INVALID_ENTITY) {
+                records[moved].location = location;
+            }
+        }
+    };
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "components/null_component.hpp"
+
+// std
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ecs {
+    using ComponentID = uint32_t;
+
+    constexpr size_t MAX_COMPONENTS = 64;
+
+    // One bit per component type, bit n is set when the entity or archetype has the component with id n.
+    using Signature = std::bitset<MAX_COMPONENTS>;
+
+    namespace detail {
+        inline ComponentID NextComponentID() {
+            static std::atomic<ComponentID> next{0};
+            ComponentID id = next.fetch_add(1, std::memory_order_relaxed);
+            if (id >= MAX_COMPONENTS) {
+                throw std::runtime_error("Too many component types, increase ecs::MAX_COMPONENTS.");
+            }
+            return id;
+        }
+
+        template <class T>
+        struct ComponentTypeID {
+            static ComponentID Get() {
+                static const ComponentID id = NextComponentID();
+                return id;
+            }
+        };
+    }
+
+    // Dense per-type id handed out the first time a component type is used. const T and T share an id.
+    template <class T>
+    inline ComponentID GetComponentID() {
+        static_assert(std::is_base_of<Component, std::remove_const_t<T>>::value, "Component ids are only given to ecs::Component types.");
+        return detail::ComponentTypeID<std::remove_const_t<T>>::Get();
+    }
+
+    template <class... Ts>
+    inline Signature MakeSignature() {
+        Signature signature;
+        (signature.set(GetComponentID<Ts>()), ...);
+        return signature;
+    }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "transform.hpp"
+
 namespace ecs {
     class Camera : public Component {
         public:
@@ -24,7 +26,37 @@ namespace ecs {
             }
 
             const qbn::mat<float, 4>& GetProjection() const { return projectionMatrix; }
+
+            // Projection times the inverse of the camera's transform, world space to clip space. The transform's
+            // scale is ignored.
+            qbn::mat<float, 4> GetViewProjection(const Transform3D& transform) const {
+                Transform3D rigid = transform;
+                rigid.scale = {1, 1, 1};
+                const qbn::mat<float, 4> model = rigid.GetModelMatrix();
+
+                // The inverse of a rotation and translation is the transposed rotation and the negated translation
+                // rotated back.
+                qbn::mat<float, 4> view{1};
+                for (int c = 0; c < 3; c++) {
+                    for (int r = 0; r < 3; r++) {
+                        view[c][r] = model[r][c];
+                    }
+                }
+                for (int r = 0; r < 3; r++) {
+                    view[3][r] = -(model[r][0] * model[3][0] + model[r][1] * model[3][1] + model[r][2] * model[3][2]);
+                }
+
+                qbn::mat<float, 4> viewProjection{0};
+                for (int c = 0; c < 4; c++) {
+                    for (int r = 0; r < 4; r++) {
+                        for (int k = 0; k < 4; k++) {
+                            viewProjection[c][r] += projectionMatrix[k][r] * view[c][k];
+                        }
+                    }
+                }
+                return viewProjection;
+            }
         private:
-            qbn::mat<float, 4> projectionMatrix;
+            qbn::mat<float, 4> projectionMatrix{1};
     };
 }
\ No newline at end of file
@@ -16,22 +16,40 @@ namespace ecs {
     class Mesh2D : public Component {
         private:
             std::shared_ptr<vkr::Mesh> mesh;
+            qbn::vec<float, 4> colour;
         public:
-            Mesh2D(std::shared_ptr<vkr::Mesh> m) : mesh{m} {}
+            Mesh2D(std::shared_ptr<vkr::Mesh> m, qbn::vec<float, 4> c = {1, 1, 1, 1}) : mesh{m}, colour{c} {}
 
-            std::shared_ptr<vkr::Mesh> GetMesh() {
+            const std::shared_ptr<vkr::Mesh>& GetMesh() const {
                 return mesh;
             }
+
+            // Multiplies the mesh's vertex colours, per instance.
+            const qbn::vec<float, 4>& GetColour() const {
+                return colour;
+            }
+            void SetColour(const qbn::vec<float, 4>& c) {
+                colour = c;
+            }
     };
 
     class Mesh3D : public Component {
         private:
             std::shared_ptr<vkr::Mesh> mesh;
+            qbn::vec<float, 4> colour;
         public:
-            Mesh3D(std::shared_ptr<vkr::Mesh> m) : mesh{m} {}
+            Mesh3D(std::shared_ptr<vkr::Mesh> m, qbn::vec<float, 4> c = {1, 1, 1, 1}) : mesh{m}, colour{c} {}
 
-            std::shared_ptr<vkr::Mesh> GetMesh() {
+            const std::shared_ptr<vkr::Mesh>& GetMesh() const {
                 return mesh;
             }
+
+            // Multiplies the mesh's vertex colours, per instance.
+            const qbn::vec<float, 4>& GetColour() const {
+                return colour;
+            }
+            void SetColour(const qbn::vec<float, 4>& c) {
+                colour = c;
+            }
     };
 }
\ No newline at end of file
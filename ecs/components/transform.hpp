@@ -4,6 +4,9 @@
 
 #include <qbn.hpp>
 
+// std
+#include <cmath>
+
 namespace ecs {
     class Transform2D : public Component {
         private:
@@ -12,6 +15,17 @@ namespace ecs {
         qbn::vec<float, 2> position{0, 0};
         qbn::vec<float, 2> scale{1, 1};
         float rotation{0};
+
+        // Scale, then rotation about z, then translation.
+        qbn::mat<float, 4> GetModelMatrix() const {
+            const float c = std::cos(rotation);
+            const float s = std::sin(rotation);
+            qbn::mat<float, 4> model{1};
+            model[0] = {c * scale[0], s * scale[0], 0, 0};
+            model[1] = {-s * scale[1], c * scale[1], 0, 0};
+            model[3] = {position[0], position[1], 0, 1};
+            return model;
+        }
     };
 
     class Transform3D : public Component {
@@ -21,5 +35,18 @@ namespace ecs {
         qbn::vec<float, 3> position{0, 0, 0};
         qbn::vec<float, 3> scale{1, 1, 1};
         qbn::vec<float, 3> rotation{0, 0, 0};
+
+        // Scale, then rotation about x, y and z in that order, then translation.
+        qbn::mat<float, 4> GetModelMatrix() const {
+            const float cx = std::cos(rotation[0]), sx = std::sin(rotation[0]);
+            const float cy = std::cos(rotation[1]), sy = std::sin(rotation[1]);
+            const float cz = std::cos(rotation[2]), sz = std::sin(rotation[2]);
+            qbn::mat<float, 4> model{1};
+            model[0] = {cy * cz * scale[0], cy * sz * scale[0], -sy * scale[0], 0};
+            model[1] = {(cz * sx * sy - cx * sz) * scale[1], (cx * cz + sx * sy * sz) * scale[1], cy * sx * scale[1], 0};
+            model[2] = {(cx * cz * sy + sx * sz) * scale[2], (cx * sy * sz - cz * sx) * scale[2], cx * cy * scale[2], 0};
+            model[3] = {position[0], position[1], position[2], 1};
+            return model;
+        }
     };
 }
\ No newline at end of file
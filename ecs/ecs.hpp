@@ -1,6 +1,8 @@
 #pragma once
 
 #include "entity.hpp"
+#include "view.hpp"
+#include "system.hpp"
 
 #include <memory>
 #include <vector>
@@ -10,28 +12,65 @@
 namespace ecs {
     class EntityManager {
         public:
-        std::vector<std::shared_ptr<Entity>> entities;
+        // Every live entity, densely packed. Removal swaps the last entity into the hole, so the order is not
+        // stable, use handles rather than positions to refer to an entity.
+        std::vector<Entity> entities;
 
-        Entity& AddEntity(std::shared_ptr<Entity> entity = std::make_shared<Entity>()) {
+        Entity AddEntity() {
+            Entity entity{&storage, storage.CreateEntity()};
+            if (denseIndices.size() <= entity.handle.index) {
+                denseIndices.resize(entity.handle.index + 1);
+            }
+            denseIndices[entity.handle.index] = static_cast<uint32_t>(entities.size());
             entities.push_back(entity);
-            return *entities.back();
+            return entity;
         }
-        void RemoveEntity(Entity& entity) {
-            int i = 0;
-            for (auto& e : entities) {
-                if (&(*e) == &entity) {
-                    entities.erase(entities.begin() + i);
-                }
-                i++;
+        void RemoveEntity(EntityHandle handle) {
+            if (!storage.IsAlive(handle)) {
+                throw std::runtime_error("Entity handle does not refer to a live entity.");
             }
+
+            uint32_t dense = denseIndices[handle.index];
+            entities[dense] = entities.back();
+            denseIndices[entities[dense].handle.index] = dense;
+            entities.pop_back();
+
+            storage.DestroyEntity(handle);
         }
-        void RemoveEntity(size_t id) {
-            if (entities.size() < id) {
-                throw std::runtime_error("Entity does not exist at specified id.");
+        void RemoveEntity(const Entity& entity) {
+            if (entity.storage != &storage) {
+                throw std::runtime_error("Entity does not belong to this entity manager.");
             }
-            entities.erase(entities.begin() + id);
+            RemoveEntity(entity.handle);
+        }
+
+        bool IsAlive(EntityHandle handle) const {
+            return storage.IsAlive(handle);
+        }
+
+        Entity GetEntity(EntityHandle handle) {
+            if (!storage.IsAlive(handle)) {
+                throw std::runtime_error("Entity handle does not refer to a live entity.");
+            }
+            return {&storage, handle};
+        }
+
+        // Every entity that has all of Ts, see ComponentView. Repeated views of the same component set share one
+        // cached query, so making a view per frame does not rescan the archetypes.
+        template <class... Ts>
+        ComponentView<Ts...> View() {
+            return ComponentView<Ts...>(storage);
+        }
+
+        template <class... Ts, class F>
+        void ForEach(F&& f) {
+            View<Ts...>().Each(std::forward<F>(f));
         }
 
         private:
+        ArchetypeStorage storage;
+
+        // Slot index to position in entities.
+        std::vector<uint32_t> denseIndices;
     };
-}
\ No newline at end of file
+}
@@ -1,55 +1,75 @@
 #pragma once
 
-#include "components/components.hpp"
+#include "archetype.hpp"
 
-#include <vector>
 #include <memory>
 #include <type_traits>
 #include <stdexcept>
-#include <iostream>
 
 namespace ecs {
+    template <class... Ts>
+    class ComponentView;
+
+    // Entities are cheap value handles into the EntityManager's archetype storage, the components themselves live
+    // in chunks. Copies refer to the same entity, and every call checks the handle's generation so using an
+    // entity after it was removed throws instead of touching whichever entity reused its slot.
     class Entity {
         private:
+        friend class EntityManager;
+        template <class... Ts>
+        friend class ComponentView;
 
-        public:
-        std::vector<std::shared_ptr<Component>> components;
+        ArchetypeStorage* storage = nullptr;
+        EntityHandle handle;
+
+        Entity(ArchetypeStorage* s, EntityHandle h) : storage{s}, handle{h} {}
+
+        ArchetypeStorage& GetStorage() const {
+            if (!storage) {
+                throw std::runtime_error("Entity has not been added to an entity manager.");
+            }
+            return *storage;
+        }
 
+        public:
         Entity() {}
 
+        EntityHandle GetHandle() const {
+            return handle;
+        }
+
+        bool IsAlive() const {
+            return storage && storage->IsAlive(handle);
+        }
+
+        bool operator==(const Entity& other) const {
+            return storage == other.storage && handle == other.handle;
+        }
+
+        bool operator!=(const Entity& other) const {
+            return !(*this == other);
+        }
+
+        // The returned reference is only valid until a component is next added to or removed from any entity
+        // sharing its archetype, as rows get moved to keep chunks dense.
         template <class T, typename... Args, typename = std::enable_if_t<std::is_base_of<Component, T>::value>>
-        T& AddComponent(Args&&... args) {
-            std::shared_ptr<T> new_component = std::make_shared<T>(std::forward<Args>(args)...);
-            for (auto const &kv : components) {
-                if (typeid(*kv) == typeid(T)) {
-                    std::cout << "Cannot add a second copy of the same component to entity." << std::endl;
-                    throw std::runtime_error("Cannot add a second copy of the same component to entity.");
-                }
-            }
-            components.push_back(std::move(new_component));
-            return *new_component;
+        T& AddComponent(Args&&... args) const {
+            return GetStorage().Add<T>(handle, std::forward<Args>(args)...);
         }
 
         template <class T, typename = std::enable_if_t<std::is_base_of<Component, T>::value>>
-        T& GetComponent() {
-            for (int i = 0; i < components.size(); i++) {
-                auto& kv = components.at(i);
-                if (typeid(*kv) == typeid(T)) {
-                    return *std::dynamic_pointer_cast<T>(kv);
-                }
-            }
-            throw std::runtime_error("Could not find component in entity.");
+        void RemoveComponent() const {
+            GetStorage().Remove<T>(handle);
+        }
+
+        template <class T, typename = std::enable_if_t<std::is_base_of<Component, T>::value>>
+        T& GetComponent() const {
+            return GetStorage().Get<T>(handle);
         }
         
         template <class T, typename = std::enable_if_t<std::is_base_of<Component, T>::value>>
-        bool HasComponent() {
-            for (int i = 0; i < components.size(); i++) {
-                auto& kv = components.at(i);
-                if (typeid(*kv) == typeid(T)) {
-                    return true;
-                }
-            }
-            return false;
+        bool HasComponent() const {
+            return GetStorage().Has<T>(handle);
         }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+namespace ecs {
+    // 64-bit entity handle. The index picks the slot in the entity table and the generation is bumped every time
+    // that slot is freed, so a handle to a destroyed entity never matches the entity that reuses its slot.
+    struct EntityHandle {
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+        uint32_t index = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        bool IsNull() const {
+            return index == INVALID_INDEX;
+        }
+
+        uint64_t Pack() const {
+            return (static_cast<uint64_t>(generation) << 32) | index;
+        }
+
+        static EntityHandle Unpack(uint64_t value) {
+            return {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32)};
+        }
+
+        bool operator==(const EntityHandle& other) const {
+            return index == other.index && generation == other.generation;
+        }
+
+        bool operator!=(const EntityHandle& other) const {
+            return !(*this == other);
+        }
+    };
+}
+
+template <>
+struct std::hash<ecs::EntityHandle> {
+    size_t operator()(const ecs::EntityHandle& handle) const {
+        return std::hash<uint64_t>{}(handle.Pack());
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "component_id.hpp"
+
+// std
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace ecs {
+    class EntityManager;
+
+    // Component access lists for SystemRegistry::Add, e.g. Add<Reads<Transform3D>, Writes<RigidBody3D>>(...).
+    template <class... Ts>
+    struct Reads {
+        static Signature Get() { return MakeSignature<Ts...>(); }
+    };
+
+    template <class... Ts>
+    struct Writes {
+        static Signature Get() { return MakeSignature<Ts...>(); }
+    };
+
+    // A per-frame update together with the components it touches. Systems may run at the same time as any other
+    // system they do not conflict with, so they must only touch the components they declared and must not add or
+    // remove entities or components. Systems that need to make structural changes are registered as exclusive
+    // and run on their own.
+    struct System {
+        std::string name;
+        Signature reads;
+        Signature writes;
+        bool exclusive = false;
+        std::function<void(EntityManager&, float)> update;
+
+        // Two systems conflict when either writes something the other reads or writes.
+        bool ConflictsWith(const System& other) const {
+            if (exclusive || other.exclusive) {
+                return true;
+            }
+            return (writes & (other.reads | other.writes)).any() || (other.writes & reads).any();
+        }
+    };
+
+    class SystemRegistry {
+        public:
+        template <class ReadList = Reads<>, class WriteList = Writes<>>
+        System& Add(std::string name, std::function<void(EntityManager&, float)> update) {
+            System system;
+            system.name = std::move(name);
+            system.reads = ReadList::Get();
+            system.writes = WriteList::Get();
+            system.update = std::move(update);
+            return Add(std::move(system));
+        }
+
+        System& AddExclusive(std::string name, std::function<void(EntityManager&, float)> update) {
+            System system;
+            system.name = std::move(name);
+            system.exclusive = true;
+            system.update = std::move(update);
+            return Add(std::move(system));
+        }
+
+        System& Add(System system) {
+            if (!system.update) {
+                throw std::runtime_error("Cannot register a system without an update function.");
+            }
+            for (auto& s : systems) {
+                if (s.name == system.name) {
+                    throw std::runtime_error("A system with this name has already been registered.");
+                }
+            }
+            systems.push_back(std::move(system));
+            revision++;
+            return systems.back();
+        }
+
+        void Remove(const std::string& name) {
+            for (size_t i = 0; i < systems.size(); i++) {
+                if (systems[i].name == name) {
+                    systems.erase(systems.begin() + i);
+                    revision++;
+                    return;
+                }
+            }
+        }
+
+        const std::vector<System>& GetSystems() const {
+            return systems;
+        }
+
+        // Bumped whenever the set of systems changes, so schedulers know to rebuild their graph.
+        uint64_t GetRevision() const {
+            return revision;
+        }
+
+        private:
+        std::vector<System> systems;
+        uint64_t revision = 0;
+    };
+}
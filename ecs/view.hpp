@@ -0,0 +1,156 @@
+#pragma once
+
+#include "entity.hpp"
+
+// std
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace ecs {
+    // Iterates every entity that has all of Ts, one chunk column at a time. Ask for const components, e.g.
+    // View<const Transform3D, Mesh3D>, to only get read access to them. Views are cheap to make and hold on to,
+    // the set of matching archetypes is kept up to date by the storage as new archetypes appear.
+    //
+    //     for (auto [transform, mesh] : em.View<Transform3D, const Mesh3D>()) {}
+    //     em.View<Transform3D>().Each([](Transform3D& transform) {});
+    //     em.View<Transform3D>().Each([](Entity entity, Transform3D& transform) {});
+    template <class... Ts>
+    class ComponentView {
+        public:
+        class Iterator {
+            public:
+            Iterator(const std::vector<Archetype*>* a, size_t index) : archetypes{a}, archetype{index} {
+                Settle();
+            }
+
+            std::tuple<Ts&...> operator*() const {
+                return std::apply([this](Ts*... column) { return std::tuple<Ts&...>(column[row]...); }, columns);
+            }
+
+            Iterator& operator++() {
+                if (++row == count) {
+                    chunk++;
+                    Settle();
+                }
+                return *this;
+            }
+
+            bool operator==(const Iterator& other) const {
+                return archetype == other.archetype && chunk == other.chunk && row == other.row;
+            }
+
+            bool operator!=(const Iterator& other) const {
+                return !(*this == other);
+            }
+
+            private:
+            const std::vector<Archetype*>* archetypes;
+            size_t archetype = 0;
+            size_t chunk = 0;
+            uint32_t row = 0;
+            uint32_t count = 0;
+            std::tuple<Ts*...> columns;
+
+            // Moves forward to the first non-empty chunk at or after the current position.
+            void Settle() {
+                row = 0;
+                while (archetype < archetypes->size()) {
+                    auto* current = (*archetypes)[archetype];
+                    auto& chunks = current->GetChunks();
+                    for (; chunk < chunks.size(); chunk++) {
+                        if (chunks[chunk].count > 0) {
+                            count = chunks[chunk].count;
+                            columns = std::tuple<Ts*...>(current->template Column<Ts>(chunk)...);
+                            return;
+                        }
+                    }
+                    archetype++;
+                    chunk = 0;
+                }
+            }
+        };
+
+        ComponentView(ArchetypeStorage& s) : storage{&s}, query{&s.GetQuery(MakeSignature<Ts...>())} {}
+
+        Iterator begin() const {
+            return Iterator(&query->archetypes, 0);
+        }
+
+        Iterator end() const {
+            return Iterator(&query->archetypes, query->archetypes.size());
+        }
+
+        // One non-empty chunk of a matching archetype, the unit parallel iteration hands out to workers.
+        struct ChunkRef {
+            Archetype* archetype;
+            size_t chunk;
+        };
+
+        // Calls f(Ts&...) or f(Entity, Ts&...) for every matching entity. f is taken as a template parameter so
+        // the per-row call can be inlined into the column loop.
+        template <class F>
+        void Each(F&& f) const {
+            for (auto* archetype : query->archetypes) {
+                auto& chunks = archetype->GetChunks();
+                for (size_t c = 0; c < chunks.size(); c++) {
+                    EachInChunk(ChunkRef{archetype, c}, f);
+                }
+            }
+        }
+
+        std::vector<ChunkRef> GetChunks() const {
+            std::vector<ChunkRef> refs;
+            for (auto* archetype : query->archetypes) {
+                auto& chunks = archetype->GetChunks();
+                for (size_t c = 0; c < chunks.size(); c++) {
+                    if (chunks[c].count > 0) {
+                        refs.push_back({archetype, c});
+                    }
+                }
+            }
+            return refs;
+        }
+
+        // Same as Each but limited to one chunk. Different chunks never share rows, so separate threads can run
+        // this on separate chunks at the same time.
+        template <class F>
+        void EachInChunk(const ChunkRef& ref, F&& f) const {
+            auto* archetype = ref.archetype;
+            const size_t c = ref.chunk;
+            const uint32_t count = archetype->GetChunks()[c].count;
+            if constexpr (std::is_invocable_v<F&, Entity, Ts&...>) {
+                const uint32_t* indices = archetype->Entities(c);
+                auto* s = storage;
+                std::apply([&](Ts*... column) {
+                    for (uint32_t row = 0; row < count; row++) {
+                        f(Entity{s, s->GetHandle(indices[row])}, column[row]...);
+                    }
+                }, std::tuple<Ts*...>(archetype->template Column<Ts>(c)...));
+            }
+            else {
+                std::apply([&](Ts*... column) {
+                    for (uint32_t row = 0; row < count; row++) {
+                        f(column[row]...);
+                    }
+                }, std::tuple<Ts*...>(archetype->template Column<Ts>(c)...));
+            }
+        }
+
+        size_t Size() const {
+            size_t size = 0;
+            for (auto* archetype : query->archetypes) {
+                size += archetype->Size();
+            }
+            return size;
+        }
+
+        bool Empty() const {
+            return Size() == 0;
+        }
+
+        private:
+        ArchetypeStorage* storage;
+        const ArchetypeStorage::Query* query;
+    };
+}
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <thread>
 #include <mutex>
+#include <string>
 #include <condition_variable>
 #include <unordered_map>
 
@@ -20,11 +21,23 @@
 
 // structs = structs used throughout project
 
-int main() {
+int main(int argc, char** argv) {
+    // --gpu-culling culls the scene on the GPU, --no-indirect-count does too but forces its fallback path.
+    vkr::SceneCulling culling = vkr::SceneCulling::Cpu;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--gpu-culling") {
+            culling = vkr::SceneCulling::Gpu;
+        }
+        else if (arg == "--no-indirect-count") {
+            culling = vkr::SceneCulling::GpuWithoutDrawIndirectCount;
+        }
+    }
+
     ecs::EntityManager em;
     vkr::VulkanRendering vkr;
     
-    thm::ThreadManager thm{vkr, em};
+    thm::ThreadManager thm{vkr, em, culling};
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "GLFW/glfw3.h"
+
+#include <qbn.hpp>
+
+// std
+#include <cstddef>
+#include <vector>
+
+// Per-instance vertex input, read once per instance from binding 1. Its attributes follow the vertex format's, so
+// the first location is passed in.
+struct InstanceData {
+    qbn::mat<float, 4> model;
+    qbn::vec<float, 4> colour;
+
+    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescributions(uint32_t firstLocation) {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+        // A mat4 input takes one location per column.
+        for (uint32_t column = 0; column < 4; column++) {
+            attributeDescriptions.push_back({firstLocation + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, model) + column * sizeof(qbn::vec<float, 4>))});
+        }
+        attributeDescriptions.push_back({firstLocation + 4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, colour)});
+
+        return attributeDescriptions;
+    }
+
+    static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions() {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+        bindingDescriptions[0].binding = 1;
+        bindingDescriptions[0].stride = sizeof(InstanceData);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return bindingDescriptions;
+    }
+};
@@ -1,3 +1,5 @@
 #pragma once
 
-#include "vertex.hpp"
\ No newline at end of file
+#include "vertex.hpp"
+#include "instance.hpp"
+#include "uniforms.hpp"
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <qbn.hpp>
+
+// Per-frame camera data, read by the vertex shaders from set 0, binding 0. Written through a UniformRing and bound
+// with a dynamic offset, so the descriptor set never changes.
+struct CameraUniform {
+    qbn::mat<float, 4> viewProjection;
+};
@@ -0,0 +1,91 @@
+#include "structs/structs.hpp"
+
+#include "vkr/vkr.hpp"
+#include "ecs/ecs.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+// Checks GpuCuller::ExtractFrustumPlanes against points with known clip-space positions, on the CPU. The culling
+// shader keeps a bounding sphere when its centre is no further than its radius behind every plane, so the planes
+// have to face inwards, cover Vulkan's 0 to w depth range and be normalised for the distances to mean anything.
+
+struct Point {
+    const char* name;
+    float x, y, z;
+    float radius;
+    bool visible;
+};
+
+// Same test as frustum_cull.comp.
+static bool SphereVisible(const float planes[6][4], const Point& p) {
+    for (int i = 0; i < 6; i++) {
+        float distance = planes[i][0] * p.x + planes[i][1] * p.y + planes[i][2] * p.z + planes[i][3];
+        if (distance < -p.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int Check(const char* matrixName, const qbn::mat<float, 4>& viewProjection, const Point* points, size_t count) {
+    float planes[6][4];
+    vkr::GpuCuller::ExtractFrustumPlanes(viewProjection, planes);
+
+    int failures = 0;
+    for (int i = 0; i < 6; i++) {
+        float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        if (std::fabs(length - 1.0f) > 1e-5f) {
+            std::printf("FAIL %s: plane %d has normal length %f\n", matrixName, i, length);
+            failures++;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (SphereVisible(planes, points[i]) != points[i].visible) {
+            std::printf("FAIL %s: %s should be %s\n", matrixName, points[i].name, points[i].visible ? "visible" : "culled");
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main() {
+    int failures = 0;
+
+    // Clip space is world space, x and y in [-1, 1] and z in [0, 1].
+    const Point identityPoints[] = {
+        {"centre", 0.0f, 0.0f, 0.5f, 0.0f, true},
+        {"corner", 1.0f, -1.0f, 1.0f, 0.0f, true},
+        {"past right", 1.5f, 0.0f, 0.5f, 0.0f, false},
+        {"past top", 0.0f, -1.5f, 0.5f, 0.0f, false},
+        {"behind near", 0.0f, 0.0f, -0.5f, 0.0f, false},
+        {"past far", 0.0f, 0.0f, 1.5f, 0.0f, false},
+        {"sphere overlapping right", 1.4f, 0.0f, 0.5f, 0.5f, true},
+        {"sphere overlapping near", 0.0f, 0.0f, -0.2f, 0.25f, true},
+    };
+    failures += Check("identity", qbn::mat<float, 4>{1}, identityPoints, sizeof(identityPoints) / sizeof(identityPoints[0]));
+
+    // 90 degrees, square, depth from 1 to 10 along +z. At z the visible x and y run from -z to z.
+    ecs::Camera camera;
+    camera.SetPerspectiveProjection(3.14159265f / 2.0f, 1.0f, 1.0f, 10.0f);
+    const Point perspectivePoints[] = {
+        {"centre", 0.0f, 0.0f, 5.0f, 0.0f, true},
+        {"inside right", 4.0f, 0.0f, 5.0f, 0.0f, true},
+        {"past right", 6.0f, 0.0f, 5.0f, 0.0f, false},
+        {"past left", -6.0f, 0.0f, 5.0f, 0.0f, false},
+        {"past bottom", 0.0f, 6.0f, 5.0f, 0.0f, false},
+        {"before near", 0.0f, 0.0f, 0.5f, 0.0f, false},
+        {"past far", 0.0f, 0.0f, 11.0f, 0.0f, false},
+        {"behind camera", 0.0f, 0.0f, -5.0f, 0.0f, false},
+        // 1 / sqrt(2) outside the right plane.
+        {"sphere reaching in from right", 6.0f, 0.0f, 5.0f, 1.0f, true},
+        {"sphere just short of right", 6.0f, 0.0f, 5.0f, 0.6f, false},
+        {"sphere reaching in past far", 0.0f, 0.0f, 10.5f, 1.0f, true},
+    };
+    failures += Check("perspective", camera.GetProjection(), perspectivePoints, sizeof(perspectivePoints) / sizeof(perspectivePoints[0]));
+
+    if (failures == 0) {
+        std::printf("Frustum planes: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace thm {
+    // Wait handle for a group of jobs. Every job submitted with a counter increments it and decrements it once it
+    // has finished, so Wait(counter) returns when the whole group is done. The first exception a job of the group
+    // throws is kept here and rethrown by Wait.
+    class JobCounter {
+        public:
+            JobCounter() = default;
+            JobCounter(const JobCounter&) = delete;
+            JobCounter& operator=(const JobCounter&) = delete;
+
+            bool IsDone() const {
+                return count.load(std::memory_order_acquire) == 0;
+            }
+
+        private:
+            friend class JobSystem;
+            std::atomic<int64_t> count{0};
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            void SetError(std::exception_ptr e) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = e;
+                }
+            }
+
+            // Clears the error, so a reused counter starts clean.
+            std::exception_ptr TakeError() {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                std::exception_ptr e = error;
+                error = nullptr;
+                return e;
+            }
+    };
+
+    class JobSystem {
+        public:
+            JobSystem(unsigned int threadCount = std::thread::hardware_concurrency()) {
+                if (threadCount == 0) {
+                    threadCount = 1;
+                }
+                deques.reserve(threadCount);
+                for (unsigned int i = 0; i < threadCount; i++) {
+                    deques.push_back(std::make_unique<WorkStealingDeque>());
+                }
+                for (unsigned int i = 0; i < threadCount; i++) {
+                    workers.emplace_back(&JobSystem::WorkerThread, this, i);
+                }
+            }
+
+            ~JobSystem() {
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    finish = true;
+                }
+                sleepCv.notify_all();
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+                for (auto& deque : deques) {
+                    while (Job* job = deque->Pop()) {
+                        delete job;
+                    }
+                }
+                for (Job* job : injected) {
+                    delete job;
+                }
+                for (Job* job : workerInjected) {
+                    delete job;
+                }
+            }
+
+            JobSystem(const JobSystem&) = delete;
+            JobSystem& operator=(const JobSystem&) = delete;
+
+            // Queues task to run on any worker. From a worker thread the job goes onto that worker's own deque,
+            // from anywhere else it goes onto the shared injection queue. Whatever task throws is handed to Wait on
+            // counter, without a counter it is dropped.
+            void Submit(std::function<void()> task, JobCounter* counter = nullptr) {
+                if (counter) {
+                    counter->count.fetch_add(1, std::memory_order_relaxed);
+                }
+                Job* job = new Job{std::move(task), counter};
+
+                int index = CurrentWorkerIndex();
+                if (index < 0 || !deques[index]->Push(job)) {
+                    std::lock_guard<std::mutex> lock(injectMutex);
+                    injected.push_back(job);
+                }
+
+                queuedJobs.fetch_add(1, std::memory_order_release);
+                sleepCv.notify_one();
+            }
+
+            // Blocks until every job submitted with counter has finished, then rethrows the first exception one of
+            // them threw. The waiting thread runs other jobs in the meantime instead of sleeping, so waiting from
+            // inside a job cannot deadlock the pool.
+            void Wait(JobCounter& counter) {
+                int index = CurrentWorkerIndex();
+                unsigned int spins = 0;
+                while (!counter.IsDone()) {
+                    if (Job* job = FindJob(index)) {
+                        Execute(job);
+                        spins = 0;
+                    }
+                    else if (++spins > 64) {
+                        std::this_thread::yield();
+                    }
+                }
+                if (std::exception_ptr error = counter.TakeError()) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            // Calls f(begin, end) over [0, count) split into batches of batchSize and waits for all of them.
+            template <class F>
+            void ParallelFor(size_t count, size_t batchSize, F&& f) {
+                if (count == 0) {
+                    return;
+                }
+                batchSize = std::max<size_t>(batchSize, 1);
+
+                JobCounter counter;
+                for (size_t begin = batchSize; begin < count; begin += batchSize) {
+                    size_t end = std::min(begin + batchSize, count);
+                    Submit([&f, begin, end]{ f(begin, end); }, &counter);
+                }
+                // The calling thread takes the first batch itself rather than idling. The queued batches refer to f
+                // and counter on this frame, so they are waited for even when it throws.
+                try {
+                    f(size_t{0}, std::min(batchSize, count));
+                }
+                catch (...) {
+                    counter.SetError(std::current_exception());
+                }
+                Wait(counter);
+            }
+
+            // ParallelFor for a caller that must not be held up by unrelated work, such as the render thread. Idle
+            // workers help with the batches, but the caller only ever runs batches of this loop, and then waits just
+            // for the ones still running elsewhere, never for whatever else is queued. A helper job that starts
+            // after the batches have all been claimed returns straight away.
+            template <class F>
+            void ParallelForIsolated(size_t count, size_t batchSize, F&& f) {
+                if (count == 0) {
+                    return;
+                }
+                batchSize = std::max<size_t>(batchSize, 1);
+
+                // Helpers may still be queued once this returns, so they hold the loop state. f is only reached
+                // through a claimed batch, and every batch has finished before this returns.
+                auto loop = std::make_shared<IsolatedLoop>();
+                loop->count = count;
+                loop->batchSize = batchSize;
+                loop->context = &f;
+                loop->call = [](void* context, size_t begin, size_t end) {
+                    (*static_cast<std::remove_reference_t<F>*>(context))(begin, end);
+                };
+
+                // Helpers only ever run on workers. A thread outside the pool waiting on something else, such as the
+                // simulation thread in Scheduler::Run, never picks one up, so batches only run on workers and here.
+                size_t helpers = std::min((count + batchSize - 1) / batchSize - 1, workers.size());
+                for (size_t h = 0; h < helpers; h++) {
+                    SubmitToWorkers([loop]{ loop->RunBatches(); });
+                }
+                loop->RunBatches();
+
+                unsigned int spins = 0;
+                while (loop->finished.load(std::memory_order_acquire) < count) {
+                    if (++spins > 64) {
+                        std::this_thread::yield();
+                    }
+                }
+                if (std::exception_ptr error = loop->errors.TakeError()) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            size_t GetThreadCount() const {
+                return workers.size();
+            }
+
+            // Index of the calling worker in [0, GetThreadCount()), -1 on any thread outside the pool. Per worker
+            // state indexed by it is never touched by two threads at once, -1 is shared by every outside thread.
+            int GetWorkerIndex() const {
+                return CurrentWorkerIndex();
+            }
+
+        private:
+            struct Job {
+                std::function<void()> task;
+                JobCounter* counter;
+            };
+
+            struct IsolatedLoop {
+                size_t count = 0;
+                size_t batchSize = 1;
+                void* context = nullptr;
+                void (*call)(void*, size_t, size_t) = nullptr;
+                std::atomic<size_t> next{0};
+                std::atomic<size_t> finished{0};
+                // Only for its error, a batch that throws still counts as finished.
+                JobCounter errors;
+
+                void RunBatches() {
+                    while (true) {
+                        size_t begin = next.fetch_add(batchSize, std::memory_order_relaxed);
+                        if (begin >= count) {
+                            return;
+                        }
+                        size_t end = std::min(begin + batchSize, count);
+                        try {
+                            call(context, begin, end);
+                        }
+                        catch (...) {
+                            errors.SetError(std::current_exception());
+                        }
+                        finished.fetch_add(end - begin, std::memory_order_release);
+                    }
+                }
+            };
+
+            // Chase-Lev deque. The owning worker pushes and pops at the bottom without locking, other workers
+            // steal from the top with a single compare-and-swap.
+            class WorkStealingDeque {
+                public:
+                    static constexpr int64_t CAPACITY = 4096;
+
+                    bool Push(Job* job) {
+                        int64_t b = bottom.load(std::memory_order_relaxed);
+                        int64_t t = top.load(std::memory_order_acquire);
+                        if (b - t >= CAPACITY) {
+                            return false;
+                        }
+                        buffer[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+                        bottom.store(b + 1, std::memory_order_release);
+                        return true;
+                    }
+
+                    Job* Pop() {
+                        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+                        bottom.store(b, std::memory_order_seq_cst);
+                        int64_t t = top.load(std::memory_order_seq_cst);
+
+                        if (t > b) {
+                            bottom.store(b + 1, std::memory_order_relaxed);
+                            return nullptr;
+                        }
+
+                        Job* job = buffer[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+                        if (t == b) {
+                            // Last job, race any thief for it.
+                            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                                job = nullptr;
+                            }
+                            bottom.store(b + 1, std::memory_order_relaxed);
+                        }
+                        return job;
+                    }
+
+                    Job* Steal() {
+                        int64_t t = top.load(std::memory_order_seq_cst);
+                        int64_t b = bottom.load(std::memory_order_seq_cst);
+                        if (t >= b) {
+                            return nullptr;
+                        }
+                        Job* job = buffer[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+                        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                            return nullptr;
+                        }
+                        return job;
+                    }
+
+                private:
+                    alignas(64) std::atomic<int64_t> top{0};
+                    alignas(64) std::atomic<int64_t> bottom{0};
+                    std::atomic<Job*> buffer[CAPACITY] = {};
+            };
+
+            std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+            std::vector<std::thread> workers;
+
+            std::deque<Job*> injected;
+            // Only taken by workers, see SubmitToWorkers.
+            std::deque<Job*> workerInjected;
+            std::mutex injectMutex;
+
+            std::atomic<int64_t> queuedJobs{0};
+            bool finish = false;
+            std::mutex sleepMutex;
+            std::condition_variable sleepCv;
+
+            static thread_local JobSystem* currentSystem;
+            static thread_local int currentIndex;
+
+            // Like Submit, but only a worker will ever run the job. It skips the deques, which threads outside the
+            // pool steal from while they wait.
+            void SubmitToWorkers(std::function<void()> task) {
+                Job* job = new Job{std::move(task), nullptr};
+                {
+                    std::lock_guard<std::mutex> lock(injectMutex);
+                    workerInjected.push_back(job);
+                }
+                queuedJobs.fetch_add(1, std::memory_order_release);
+                sleepCv.notify_one();
+            }
+
+            int CurrentWorkerIndex() const {
+                return currentSystem == this ? currentIndex : -1;
+            }
+
+            Job* FindJob(int index) {
+                if (index >= 0) {
+                    if (Job* job = deques[index]->Pop()) {
+                        return job;
+                    }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(injectMutex);
+                    if (!injected.empty()) {
+                        Job* job = injected.front();
+                        injected.pop_front();
+                        return job;
+                    }
+                    if (index >= 0 && !workerInjected.empty()) {
+                        Job* job = workerInjected.front();
+                        workerInjected.pop_front();
+                        return job;
+                    }
+                }
+
+                // Start stealing at a random victim so thieves do not all hammer the same deque.
+                static thread_local std::minstd_rand random{std::random_device{}()};
+                size_t count = deques.size();
+                size_t start = random() % count;
+                for (size_t i = 0; i < count; i++) {
+                    size_t victim = (start + i) % count;
+                    if (static_cast<int>(victim) == index) {
+                        continue;
+                    }
+                    if (Job* job = deques[victim]->Steal()) {
+                        return job;
+                    }
+                }
+                return nullptr;
+            }
+
+            void Execute(Job* job) {
+                queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+                try {
+                    job->task();
+                }
+                catch (...) {
+                    if (job->counter) {
+                        job->counter->SetError(std::current_exception());
+                    }
+                }
+                if (job->counter) {
+                    job->counter->count.fetch_sub(1, std::memory_order_acq_rel);
+                }
+                delete job;
+            }
+
+            void WorkerThread(int index) {
+                currentSystem = this;
+                currentIndex = index;
+
+                unsigned int spins = 0;
+                while (true) {
+                    if (Job* job = FindJob(index)) {
+                        Execute(job);
+                        spins = 0;
+                        continue;
+                    }
+
+                    if (++spins < 64) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> lock(sleepMutex);
+                    if (finish) {
+                        return;
+                    }
+                    // Timed so a job pushed onto another worker's deque without a matching wake-up still gets stolen.
+                    sleepCv.wait_for(lock, std::chrono::milliseconds(1), [this]{ return finish || queuedJobs.load(std::memory_order_acquire) > 0; });
+                    spins = 0;
+                }
+            }
+    };
+
+    inline thread_local JobSystem* JobSystem::currentSystem = nullptr;
+    inline thread_local int JobSystem::currentIndex = -1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "../ecs/view.hpp"
+
+namespace thm {
+    // Runs f over every entity in view, handing out one archetype chunk per job. Chunks are sized to stay resident
+    // in cache, so each job streams through its columns without sharing cache lines with another job. f must only
+    // touch the row it is given, the same rule as for any other parallel system.
+    template <class... Ts, class F>
+    void ParallelForEach(JobSystem& jobs, const ecs::ComponentView<Ts...>& view, F&& f) {
+        auto chunks = view.GetChunks();
+        jobs.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                view.EachInChunk(chunks[i], f);
+            }
+        });
+    }
+}
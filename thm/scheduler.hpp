@@ -0,0 +1,135 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "../ecs/system.hpp"
+
+// std
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace thm {
+    // Runs the registered systems once per frame, overlapping every pair of systems whose declared component
+    // access does not conflict. Systems that do conflict keep their registration order.
+    class Scheduler {
+        public:
+            struct SystemStats {
+                std::string name;
+                double milliseconds = 0.0;
+            };
+
+            Scheduler(ecs::SystemRegistry& r, JobSystem& j) : registry{r}, jobs{j} {
+
+            }
+
+            void Run(ecs::EntityManager& em, float dt) {
+                if (builtRevision != registry.GetRevision() || nodes.size() != registry.GetSystems().size()) {
+                    BuildGraph();
+                }
+                if (nodes.empty()) {
+                    return;
+                }
+
+                entityManager = &em;
+                deltaTime = dt;
+                error = nullptr;
+                for (auto& node : nodes) {
+                    node.pending.store(node.dependencyCount, std::memory_order_relaxed);
+                }
+
+                for (size_t i = 0; i < nodes.size(); i++) {
+                    if (nodes[i].dependencyCount == 0) {
+                        Dispatch(i);
+                    }
+                }
+
+                // Dependents are submitted from inside their last dependency's job, which always happens before
+                // that job releases the counter, so the counter only reaches zero once every system has run.
+                jobs.Wait(counter);
+
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            // Time each system took during the last Run.
+            std::vector<SystemStats> GetStats() const {
+                std::vector<SystemStats> stats;
+                auto& systems = registry.GetSystems();
+                for (size_t i = 0; i < nodes.size() && i < systems.size(); i++) {
+                    stats.push_back({systems[i].name, nodes[i].milliseconds});
+                }
+                return stats;
+            }
+
+        private:
+            struct Node {
+                std::vector<size_t> dependents;
+                size_t dependencyCount = 0;
+                std::atomic<size_t> pending{0};
+                double milliseconds = 0.0;
+
+                Node() = default;
+                Node(Node&& other) : dependents{std::move(other.dependents)}, dependencyCount{other.dependencyCount} {}
+            };
+
+            ecs::SystemRegistry& registry;
+            JobSystem& jobs;
+
+            std::vector<Node> nodes;
+            uint64_t builtRevision = ~0ull;
+
+            ecs::EntityManager* entityManager = nullptr;
+            float deltaTime = 0.0f;
+
+            JobCounter counter;
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            // Adds an edge from every system to each later system it conflicts with, so the graph is acyclic and
+            // conflicting systems run in registration order.
+            void BuildGraph() {
+                auto& systems = registry.GetSystems();
+                nodes.clear();
+                nodes.resize(systems.size());
+
+                for (size_t i = 0; i < systems.size(); i++) {
+                    for (size_t j = i + 1; j < systems.size(); j++) {
+                        if (systems[i].ConflictsWith(systems[j])) {
+                            nodes[i].dependents.push_back(j);
+                            nodes[j].dependencyCount++;
+                        }
+                    }
+                }
+
+                builtRevision = registry.GetRevision();
+            }
+
+            void Dispatch(size_t index) {
+                jobs.Submit([this, index]{ Execute(index); }, &counter);
+            }
+
+            void Execute(size_t index) {
+                auto& node = nodes[index];
+                auto start = std::chrono::high_resolution_clock::now();
+                try {
+                    registry.GetSystems()[index].update(*entityManager, deltaTime);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                node.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+                for (size_t dependent : node.dependents) {
+                    if (nodes[dependent].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        Dispatch(dependent);
+                    }
+                }
+            }
+    };
+}
@@ -1,103 +1,99 @@
 #pragma once
 
+#include "job_system.hpp"
+#include "parallel_for.hpp"
+#include "scheduler.hpp"
+
+#include <atomic>
+#include <chrono>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 
 namespace thm {
     class ThreadManager {
         public:
-            ThreadManager(vkr::VulkanRendering& v, ecs::EntityManager& e) : vkr{v}, em{e} {
+            ThreadManager(vkr::VulkanRendering& v, ecs::EntityManager& e, vkr::SceneCulling c = vkr::SceneCulling::Cpu) : vkr{v}, em{e}, culling{c} {
                 InitializeThreads();
 
                 // Everything below is testing (except for functions)
 
                 std::this_thread::sleep_for(std::chrono::seconds(1)); // NEED TO CHANGE THIS AT SOME POINT TO JUST BE SYNCED
-                auto& entity = em.AddEntity();
-                AddEntityToRenderer<vkr::TriangleRenderer2D>(em.entities.at(0));
-                CopyToVulkanRenderingThread();
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    render_pause = true;
-                    cv.notify_all();
-                }
+                auto entity = em.AddEntity();
                 std::vector<Vertex2D> vertices = {{{0.5,0.5},{1,0,0,1},{0,0}},{{-0.5,0.5},{0,1,0,1},{0,0}},{{0,-0.5},{0,0,1,1},{0,0}}};
                 auto mesh = vkr.GetMeshPool()->CreateMesh(vertices);
+                entity.AddComponent<ecs::Transform2D>();
                 entity.AddComponent<ecs::Mesh2D>(mesh);
-                auto& entity2 = em.AddEntity();
-                AddEntityToRenderer<vkr::TriangleRenderer2D>(em.entities.at(1));
+                auto entity2 = em.AddEntity();
                 std::vector<Vertex2D> vertices2 = {{{0.2,0.2},{1,1,0,1},{0,0}},{{-0.2,0.2},{0,1,1,1},{0,0}},{{0,-0.2},{1,0,1,1},{0,0}}};
                 auto mesh2 = vkr.GetMeshPool()->CreateMesh(vertices2);
+                entity2.AddComponent<ecs::Transform2D>();
                 entity2.AddComponent<ecs::Mesh2D>(mesh2);
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    render_pause = false;
-                    cv.notify_all();
-                }
-                CopyToVulkanRenderingThread();
 
-                vkrThread.join();
+                SimulationLoop();
             }
 
+            // The render loop gets a thread of its own for the lifetime of the window rather than a worker, so every
+            // worker stays free for systems and parallel loops, and GLFW is only ever called from the one thread.
             void InitializeThreads() {
-                vkrThread = std::thread(&ThreadManager::VulkanRenderingThread, this);
+                rendering = true;
+                renderThread = std::thread([this]{
+                    VulkanRenderingThread();
+                    rendering = false;
+                });
             }
 
             void VulkanRenderingThread() {
                 vkr.Init();
-                RendererEntities[std::make_shared<vkr::TriangleRenderer3D>(vkr.GetDevice(), vkr.GetSwapchain())] = {};
-                RendererEntities[std::make_shared<vkr::TriangleRenderer2D>(vkr.GetDevice(), vkr.GetSwapchain())] = {};
+                vkr.SetJobSystem(jobs);
+                vkr.AddSceneRenderer(culling);
+                vkr.AddRenderer(std::make_shared<vkr::TriangleRenderer2D>(vkr.GetDevice(), vkr.GetSwapchain(), vkr.GetPipelineLibrary()));
                 while (!glfwWindowShouldClose(vkr.GetWindow().getWindow())) {
-                    std::unique_lock<std::mutex> lock(mtx);
-                    cv.wait(lock, [this]{ return !render_pause; });
                     vkr.Run();
                 }
             }
 
-            void CopyToVulkanRenderingThread() {
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    render_pause = true;
-                    cv.notify_all();
-                }
-                CopyRendererEntitiesToRenderers();
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    render_pause = false;
-                    cv.notify_all();
+            // Runs the systems and publishes a render snapshot every tick until the window closes. The render loop
+            // only ever reads the latest published snapshot, so neither side waits on the other.
+            void SimulationLoop() {
+                auto previous = std::chrono::steady_clock::now();
+                while (rendering) {
+                    auto now = std::chrono::steady_clock::now();
+                    RunSystems(std::chrono::duration<float>(now - previous).count());
+                    vkr.ExtractSnapshot(em);
+                    previous = now;
+
+                    std::this_thread::sleep_until(now + SIMULATION_STEP);
                 }
+                renderThread.join();
             }
 
             void UpdateMeshPool() {
 
             }
 
-            template <class T, typename = std::enable_if_t<std::is_base_of<vkr::Renderer, T>::value>>
-            void AddEntityToRenderer(std::shared_ptr<ecs::Entity> entity) {
-                for (auto& pair : RendererEntities) {
-                    if (typeid(*pair.first) == typeid(T)) {
-                        pair.second.push_back(entity);
-                        break;
-                    }
-                }
+            JobSystem& GetJobs() {
+                return jobs;
+            }
+
+            ecs::SystemRegistry& GetSystems() {
+                return systems;
             }
 
-            void CopyRendererEntitiesToRenderers() {
-                vkr.SetRendererEntities(RendererEntities);
+            // Runs one frame of every registered system, overlapping the ones that do not conflict.
+            void RunSystems(float dt) {
+                scheduler.Run(em, dt);
             }
         private:
             vkr::VulkanRendering& vkr;
             ecs::EntityManager& em;
+            vkr::SceneCulling culling;
 
-            std::unordered_map<std::shared_ptr<vkr::Renderer>, std::vector<std::shared_ptr<ecs::Entity>>> RendererEntities;
-
-            std::thread vkrThread;
-            std::thread emThread;
+            JobSystem jobs{std::max(2u, std::thread::hardware_concurrency())};
+            ecs::SystemRegistry systems;
+            Scheduler scheduler{systems, jobs};
 
-            bool finish = false;
-            bool render_pause = false;
+            std::thread renderThread;
+            std::atomic<bool> rendering{false};
 
-            std::mutex mtx;
-            std::condition_variable cv;
+            static constexpr std::chrono::microseconds SIMULATION_STEP{8333};
     };
 }
\ No newline at end of file
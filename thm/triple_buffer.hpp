@@ -0,0 +1,42 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace thm {
+    // Single producer, single consumer hand-off of whole frames of data. The producer always has a buffer of its
+    // own to fill, the consumer always has the latest complete one to read, and the third sits in between. Swaps
+    // are one atomic exchange, so neither side ever waits on the other.
+    template <class T>
+    class TripleBuffer {
+        public:
+            // Buffer the producer fills next. It still holds whatever was written into it two publishes ago.
+            T& GetWriteBuffer() {
+                return buffers[writeIndex];
+            }
+
+            // Hands the write buffer to the consumer and takes back the one in the middle.
+            void Publish() {
+                writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+            }
+
+            // Newest published buffer. Returns the same buffer as last time when nothing new has been published.
+            T& Acquire() {
+                if (middle.load(std::memory_order_relaxed) & FRESH) {
+                    readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+                }
+                return buffers[readIndex];
+            }
+
+        private:
+            static constexpr uint8_t INDEX_MASK = 0x3;
+            static constexpr uint8_t FRESH = 0x4;
+
+            std::array<T, 3> buffers{};
+            uint8_t writeIndex = 0;
+            std::atomic<uint8_t> middle{1};
+            uint8_t readIndex = 2;
+    };
+}
@@ -1,67 +1,157 @@
 #pragma once
 
-#include "../../ecs/ecs.hpp"
-
 // std
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <vector>
 
 namespace vkr {
     class Renderer {
         public:
-        Renderer(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s, VkPrimitiveTopology topology, std::string vertpath, std::string fragpath, uint32_t tI = 0) : device{d}, swapchain{s}, TOPOLOGY{topology}, VERT_PATH{vertpath}, FRAG_PATH{fragpath}, typeIndex{tI} {
-
+        // Renderers with the same state share one pipeline through the library.
+        Renderer(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s, std::shared_ptr<PipelineLibrary> pl, VkPrimitiveTopology topology, std::string vertpath, std::string fragpath, uint32_t tI = 0) : device{d}, swapchain{s}, pipelineLibrary{pl}, TOPOLOGY{topology}, VERT_PATH{vertpath}, FRAG_PATH{fragpath}, typeIndex{tI} {
+            RequestPipeline();
         }
         virtual ~Renderer() = default;
 
-        virtual std::vector<std::shared_ptr<ecs::Entity>>& GetEntities() {
-            return entities;
+        // Asks the library for the pipeline against the swapchain's current render pass, again whenever the render
+        // pass is replaced. Returns the previous handle, to be kept alive until frames still using it have finished.
+        std::shared_ptr<PipelineHandle> RequestPipeline() {
+            auto config = Pipeline::DefaultPipelineConfig(TOPOLOGY);
+            // 2D is an overlay drawn after the 3D scene, in submission order.
+            if (typeIndex == 1) {
+                config.depthStencilInfo.depthTestEnable = VK_FALSE;
+                config.depthStencilInfo.depthWriteEnable = VK_FALSE;
+            }
+            std::shared_ptr<PipelineHandle> previous = std::move(pipeline);
+            pipeline = pipelineLibrary->GetPipeline(config, VERT_PATH, FRAG_PATH, typeIndex, swapchain->GetRenderPassLayout());
+            return previous;
         }
 
-        virtual void Render(VkCommandBuffer commandBuffer) {
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.GetPipeline());
+        // Outside the render pass, before any renderer's Render. For work such as compute passes.
+        virtual void Prepare(const RenderContext& context) {}
 
-            for (auto& entity : entities) {
-                if (entity->HasComponent<ecs::Mesh2D>()) {
-                    auto buffer = entity->GetComponent<ecs::Mesh2D>().GetMesh()->GetVertexBuffer();
+        virtual void Render(const RenderContext& context) {
+            RenderChunk(context, 0, 1);
+        }
 
-                    VkBuffer buffers[] = {buffer->GetBuffer()};
-                    VkDeviceSize offsets[] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-                    vkCmdDraw(commandBuffer, buffer->GetInstanceCount(), 1, 0, 0);
-                }
-                else if (entity->HasComponent<ecs::Mesh3D>()) {
-                    auto buffer = entity->GetComponent<ecs::Mesh3D>().GetMesh()->GetVertexBuffer();
+        // How many pieces this frame's draws split into for recording in parallel, each into its own command buffer
+        // that starts with no state bound.
+        virtual uint32_t GetChunkCount(const RenderContext& context) {
+            size_t drawCount = GetDraws(context).size();
+            return static_cast<uint32_t>(std::max<size_t>((drawCount + DRAWS_PER_CHUNK - 1) / DRAWS_PER_CHUNK, 1));
+        }
 
-                    VkBuffer buffers[] = {buffer->GetBuffer()};
-                    VkDeviceSize offsets[] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-                    vkCmdDraw(commandBuffer, buffer->GetInstanceCount(), 1, 0, 0);
-                }
+        // Identifies everything RenderChunk would record, so an unchanged chunk can be executed again from last time's
+        // command buffer. 0 records it every frame.
+        virtual uint64_t GetChunkKey(const RenderContext& context, uint32_t chunk, uint32_t chunkCount) {
+            // Handles and pointers are reused once freed, so the pipeline and instance buffer go in by generation.
+            // The frame set lives as long as the recorder's cache and never changes.
+            uint64_t pipelineGeneration = pipeline->GetGeneration();
+            if (pipelineGeneration == 0) {
+                return 0;
             }
+            uint64_t key = HashCombine(0, id);
+            key = HashCombine(key, pipelineGeneration);
+            key = HashCombine(key, chunk);
+            key = HashCombine(key, chunkCount);
+            key = HashCombine(key, context.instanceGeneration);
+            key = HashCombine(key, context.cameraOffset);
+
+            auto& draws = GetDraws(context);
+            size_t begin = draws.size() * chunk / chunkCount;
+            size_t end = draws.size() * (chunk + 1) / chunkCount;
+            key = HashCombine(key, end - begin);
+            for (size_t i = begin; i < end; i++) {
+                key = HashCombine(key, draws[i].revision);
+            }
+            return key;
+        }
+
+        // Records the chunk'th of chunkCount even slices of the draws. Called from any worker, chunks of the same
+        // frame at the same time, so nothing here may write to the renderer.
+        virtual void RenderChunk(const RenderContext& context, uint32_t chunk, uint32_t chunkCount) {
+            auto& draws = GetDraws(context);
+            size_t begin = draws.size() * chunk / chunkCount;
+            size_t end = draws.size() * (chunk + 1) / chunkCount;
+            if (begin == end) {
+                return;
+            }
+
+            if (!BindFrame(context)) {
+                return;
+            }
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(context.commandBuffer, 1, 1, &context.instanceBuffer, &offset);
+            DrawMeshes(context.commandBuffer, draws.data() + begin, draws.data() + end);
         }
 
         protected:
+            // Enough per chunk that binding state at the start of each is noise next to the draws.
+            static constexpr size_t DRAWS_PER_CHUNK = 1024;
+
             std::shared_ptr<Device> device;
             std::shared_ptr<Swapchain> swapchain;
-
-            std::vector<std::shared_ptr<ecs::Entity>> entities;
+            std::shared_ptr<PipelineLibrary> pipelineLibrary;
 
             std::string VERT_PATH;
             std::string FRAG_PATH;
             VkPrimitiveTopology TOPOLOGY;
             uint32_t typeIndex;
 
-            Pipeline pipeline{*device, *swapchain, TOPOLOGY, VERT_PATH, FRAG_PATH, typeIndex};
+            // Compiled in the background, see PipelineLibrary. Nothing is drawn until it is ready.
+            std::shared_ptr<PipelineHandle> pipeline;
+            // Stands in for this in chunk keys, a later renderer may be allocated at the same address.
+            const uint64_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+
+            static inline std::atomic<uint64_t> nextId{1};
+
+            // Binds the pipeline with the frame's camera. False while there is no pipeline to draw with yet.
+            bool BindFrame(const RenderContext& context) {
+                Pipeline* bound = pipeline->GetPipeline();
+                if (bound == nullptr) {
+                    return false;
+                }
+                vkCmdBindPipeline(context.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound->GetPipeline());
+                vkCmdBindDescriptorSets(context.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound->GetPipelineLayout(), 0, 1, &context.frameSet, 1, &context.cameraOffset);
+                return true;
+            }
+
+            // The pipeline's vertex layout decides which meshes it can draw (0 = 3D, 1 = 2D).
+            const std::vector<RenderSnapshot::Draw>& GetDraws(const RenderContext& context) const {
+                return typeIndex == 1 ? context.snapshot.draws2D : context.snapshot.draws3D;
+            }
+
+            // Draws come sorted by buffer, so with every mesh in one arena page this binds once. Each draw is every
+            // instance of one mesh.
+            void DrawMeshes(VkCommandBuffer commandBuffer, const RenderSnapshot::Draw* begin, const RenderSnapshot::Draw* end) {
+                VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+                VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+                for (auto* it = begin; it != end; ++it) {
+                    auto& draw = *it;
+                    if (draw.vertexBuffer != boundVertexBuffer) {
+                        VkDeviceSize offset = 0;
+                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &draw.vertexBuffer, &offset);
+                        boundVertexBuffer = draw.vertexBuffer;
+                    }
+                    if (draw.indexBuffer != boundIndexBuffer) {
+                        vkCmdBindIndexBuffer(commandBuffer, draw.indexBuffer, 0, draw.indexType);
+                        boundIndexBuffer = draw.indexBuffer;
+                    }
+                    vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+                }
+            }
     };
     class TriangleRenderer2D : public Renderer {
         public:
-            TriangleRenderer2D(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s) : Renderer{d, s, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, "../vkr/renderers/shaders/SPIR-V/base_triangle_2d.vert.spv", "../vkr/renderers/shaders/SPIR-V/base_triangle_2d.frag.spv", 1} {
+            TriangleRenderer2D(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s, std::shared_ptr<PipelineLibrary> pl) : Renderer{d, s, pl, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, "../vkr/renderers/shaders/SPIR-V/base_triangle_2d.vert.spv", "../vkr/renderers/shaders/SPIR-V/base_triangle_2d.frag.spv", 1} {
             }
             ~TriangleRenderer2D() {}
     };
     class TriangleRenderer3D : public Renderer {
         public:
-            TriangleRenderer3D(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s) : Renderer{d, s, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, "../vkr/renderers/shaders/SPIR-V/base_triangle_3d.vert.spv", "../vkr/renderers/shaders/SPIR-V/base_triangle_3d.frag.spv"} {
+            TriangleRenderer3D(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s, std::shared_ptr<PipelineLibrary> pl) : Renderer{d, s, pl, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, "../vkr/renderers/shaders/SPIR-V/base_triangle_3d.vert.spv", "../vkr/renderers/shaders/SPIR-V/base_triangle_3d.frag.spv"} {
             
             }
             ~TriangleRenderer3D() {}
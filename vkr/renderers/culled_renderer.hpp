@@ -0,0 +1,69 @@
+#pragma once
+
+#include "base_renderer.hpp"
+
+// std
+#include <memory>
+
+namespace vkr {
+    // How the 3D scene is drawn, see VulkanRendering::AddSceneRenderer.
+    enum class SceneCulling {
+        // TriangleRenderer3D, every draw in the snapshot is recorded on the CPU.
+        Cpu,
+        // CulledRenderer3D, with vkCmdDrawIndexedIndirectCount where the device has it.
+        Gpu,
+        // CulledRenderer3D on the path for devices without VK_KHR_draw_indirect_count, even where it is available.
+        GpuWithoutDrawIndirectCount
+    };
+
+    // Draws the 3D meshes through GpuCuller, only instances inside the camera frustum reach the vertex shader and
+    // the CPU cost per frame does not grow with the instance count. Use instead of TriangleRenderer3D.
+    class CulledRenderer3D : public Renderer {
+        public:
+            CulledRenderer3D(std::shared_ptr<Device> d, std::shared_ptr<Swapchain> s, std::shared_ptr<PipelineLibrary> pl, std::shared_ptr<BufferManager> bm, bool allowDrawIndirectCount = true) : Renderer{d, s, pl, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, "../vkr/renderers/shaders/SPIR-V/base_triangle_3d.vert.spv", "../vkr/renderers/shaders/SPIR-V/base_triangle_3d.frag.spv"}, bufferManager{bm},
+                culler{*d, *bm, *pl, static_cast<uint32_t>(s->MAX_FRAMES_IN_FLIGHT), "../vkr/renderers/shaders/SPIR-V/frustum_cull.comp.spv", "../vkr/renderers/shaders/SPIR-V/emit_draws.comp.spv", allowDrawIndirectCount} {
+
+            }
+            ~CulledRenderer3D() {}
+
+            bool UsesDrawIndirectCount() const {
+                return culler.UsesDrawIndirectCount();
+            }
+
+            void Prepare(const RenderContext& context) override {
+                // Nothing would draw the results yet. GpuCuller waits for its own compute pipelines.
+                if (pipeline->GetPipeline() == nullptr) {
+                    return;
+                }
+                culler.Record(context.commandBuffer, context.frameIndex, context.instanceBuffer, context.snapshot.draws3D, context.snapshot.viewProjection);
+            }
+
+            void Render(const RenderContext& context) override {
+                if (context.snapshot.draws3D.empty()) {
+                    return;
+                }
+                if (!BindFrame(context)) {
+                    return;
+                }
+                culler.Draw(context.commandBuffer, context.frameIndex);
+            }
+
+            // A handful of indirect draws, nothing worth splitting.
+            uint32_t GetChunkCount(const RenderContext& context) override {
+                return 1;
+            }
+
+            // The indirect draws follow the groups GpuCuller rebuilds in every Prepare.
+            uint64_t GetChunkKey(const RenderContext& context, uint32_t chunk, uint32_t chunkCount) override {
+                return 0;
+            }
+
+            void RenderChunk(const RenderContext& context, uint32_t chunk, uint32_t chunkCount) override {
+                Render(context);
+            }
+
+        private:
+            std::shared_ptr<BufferManager> bufferManager;
+            GpuCuller culler;
+    };
+}
@@ -1,3 +1,4 @@
 #pragma once
 
-#include "base_renderer.hpp"
\ No newline at end of file
+#include "base_renderer.hpp"
+#include "culled_renderer.hpp"
\ No newline at end of file
@@ -4,9 +4,13 @@ layout(location = 0) in vec2 position;
 layout(location = 1) in vec4 color;
 layout(location = 2) in vec2 tex;
 
+layout(location = 3) in mat4 model;
+layout(location = 7) in vec4 instanceColor;
+
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(position, 0, 1);
-    fragColor = color.xyz;
+    // 2D draws are in screen space, the camera at set 0 only applies to 3D.
+    gl_Position = model * vec4(position, 0, 1);
+    fragColor = color.xyz * instanceColor.xyz;
 }
\ No newline at end of file
@@ -5,9 +5,16 @@ layout(location = 1) in vec3 normal;
 layout(location = 2) in vec4 color;
 layout(location = 3) in vec2 tex;
 
+layout(location = 4) in mat4 model;
+layout(location = 8) in vec4 instanceColor;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProjection;
+} camera;
+
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(position, 1);
-    fragColor = color.xyz;
+    gl_Position = camera.viewProjection * model * vec4(position, 1);
+    fragColor = color.xyz * instanceColor.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+// Shared by frustum_cull.comp and emit_draws.comp, must match GpuCuller.
+
+struct Instance {
+    mat4 model;
+    vec4 colour;
+};
+
+struct Batch {
+    vec4 sphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint instanceCount;
+    uint group;
+    uint commandIndex;
+    uint commandBase;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, set = 0, binding = 1) readonly buffer Batches { Batch batches[]; };
+layout(std430, set = 0, binding = 2) buffer BatchCounts { uint batchCounts[]; };
+layout(std430, set = 0, binding = 3) writeonly buffer Visible { Instance visible[]; };
+layout(std430, set = 0, binding = 4) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, set = 0, binding = 5) buffer DrawCounts { uint drawCounts[]; };
+
+layout(push_constant) uniform Push {
+    vec4 planes[6];
+    uint objectBase;
+    uint objectCount;
+    uint batchCount;
+    uint compact;
+} push;
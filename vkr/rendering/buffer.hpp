@@ -0,0 +1,150 @@
+#pragma once
+
+#include "../../structs/vertex.hpp"
+#include "memory_allocator.hpp"
+
+// std
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace vkr {
+    class Buffer {
+        public:
+            VkDeviceSize GetAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment) {
+                if (minOffsetAlignment > 0) {
+                    return (instanceSize + minOffsetAlignment - 1) & ~(minOffsetAlignment - 1);
+                }
+                return instanceSize;
+            }
+
+            Buffer(Device& d, MemoryAllocator& a, VkDeviceSize is, uint32_t ic, VkBufferUsageFlags uf, VkMemoryPropertyFlags mpf, VkDeviceSize moa) : device{d}, allocator{a}, instanceSize{is}, instanceCount{ic}, usageFlags{uf}, memoryPropertyFlags{mpf} {
+                alignmentSize = GetAlignment(is, moa);
+                bufferSize = alignmentSize * instanceCount;
+
+                VkBufferCreateInfo bufferInfo{};
+                bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferInfo.size = bufferSize;
+                bufferInfo.usage = usageFlags;
+                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+                if (vkCreateBuffer(device.GetDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create buffer.");
+                }
+
+                allocation = allocator.AllocateForBuffer(buffer, mpf);
+            }
+
+            ~Buffer() {
+                Destroy();
+            }
+
+            // Frees the buffer and its memory now. Safe to call more than once, the destructor becomes a no-op.
+            void Destroy() {
+                if (buffer == VK_NULL_HANDLE) {
+                    return;
+                }
+                Unmap();
+                vkDestroyBuffer(device.GetDevice(), buffer, nullptr);
+                allocator.Free(allocation);
+                buffer = VK_NULL_HANDLE;
+            }
+
+            // Host visible memory is mapped once by the allocator for the lifetime of its block, so this only
+            // hands out a pointer into that mapping.
+            VkResult Map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
+                if (!allocation.mapped) {
+                    return VK_ERROR_MEMORY_MAP_FAILED;
+                }
+                mapped = static_cast<char*>(allocation.mapped) + offset;
+                return VK_SUCCESS;
+            }
+
+            void Unmap() {
+                mapped = nullptr;
+            }
+
+            void WriteToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
+                if (!mapped) {
+                    throw std::runtime_error("Cannot copy to unmapped buffer.");
+                }
+
+                if (size == VK_WHOLE_SIZE) {
+                    memcpy(mapped, data, bufferSize);
+                }
+                else {
+                    char* memOffset = (char*)mapped;
+                    memOffset += offset;
+                    memcpy(memOffset, data, size);
+                }
+            }
+
+            VkResult Flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
+                VkMappedMemoryRange mappedRange = GetMappedRange(size, offset);
+                return vkFlushMappedMemoryRanges(device.GetDevice(), 1, &mappedRange);
+            }
+
+            VkResult Invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
+                VkMappedMemoryRange mappedRange = GetMappedRange(size, offset);
+                return vkInvalidateMappedMemoryRanges(device.GetDevice(), 1, &mappedRange);
+            }
+
+            VkBuffer& GetBuffer() {
+                return buffer;
+            }
+
+            VkDeviceMemory& GetBufferMemory() {
+                return allocation.memory;
+            }
+
+            const Allocation& GetAllocation() const {
+                return allocation;
+            }
+
+            uint32_t& GetInstanceCount() {
+                return instanceCount;
+            }
+
+            VkDeviceSize& GetInstanceSize() {
+                return instanceSize;
+            }
+
+            VkDeviceSize& GetAlignmentSize() {
+                return alignmentSize;
+            }
+
+            VkDeviceSize& GetBufferSize() {
+                return bufferSize;
+            }
+
+        private:
+            Device& device;
+            MemoryAllocator& allocator;
+
+            void* mapped = nullptr;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            Allocation allocation;
+
+            VkDeviceSize bufferSize;
+            uint32_t instanceCount;
+            VkDeviceSize instanceSize;
+            VkDeviceSize alignmentSize;
+            VkBufferUsageFlags usageFlags;
+            VkMemoryPropertyFlags memoryPropertyFlags;
+
+            // Only if buffer is vertex or index buffer
+            std::shared_ptr<std::vector<Vertex2D>> vertices2D;
+            std::shared_ptr<std::vector<Vertex3D>> vertices3D;
+            std::shared_ptr<std::vector<uint32_t>> indices;
+
+            // Offsets are relative to the buffer, the memory object is shared with other buffers in the block.
+            VkMappedMemoryRange GetMappedRange(VkDeviceSize size, VkDeviceSize offset) {
+                VkMappedMemoryRange mappedRange = {};
+                mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                mappedRange.memory = allocation.memory;
+                mappedRange.offset = allocation.offset + offset;
+                mappedRange.size = size == VK_WHOLE_SIZE ? allocation.rangeSize - offset : size;
+                return mappedRange;
+            }
+    };
+}
@@ -1,168 +1,76 @@
 #pragma once
 
 #include "../../structs/vertex.hpp"
+#include "memory_allocator.hpp"
+#include "buffer.hpp"
+#include "image.hpp"
+#include "uploader.hpp"
 
+#include <functional>
 #include <memory>
+#include <mutex>
 
 namespace vkr {
-    class Buffer {
+    class BufferManager {
         public:
-            VkDeviceSize GetAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment) {
-                if (minOffsetAlignment > 0) {
-                    return (instanceSize + minOffsetAlignment - 1) & ~(minOffsetAlignment - 1);
-                }
-                return instanceSize;
-            }
+            // The allocator is shared with the swapchain's depth images, so it is created before either.
+            BufferManager(Device& d, CommandPool& c, MemoryAllocator& a) : device{d}, command_pool{c}, allocator{a}, uploader{d, allocator} {
 
-            uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-                VkPhysicalDeviceMemoryProperties memProperties;
-                vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &memProperties);
-                for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-                    if ((typeFilter & (1 << i)) &&
-                        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                        return i;
-                    }
-                }
-                throw std::runtime_error("Failed to find suitable memory type.");
             }
 
-            Buffer(Device& d, VkDeviceSize is, uint32_t ic, VkBufferUsageFlags uf, VkMemoryPropertyFlags mpf, VkDeviceSize moa) : device{d}, instanceSize{is}, instanceCount{ic}, usageFlags{uf}, memoryPropertyFlags{mpf} {
-                alignmentSize = GetAlignment(is, moa);
-                bufferSize = alignmentSize * instanceCount;
-
-                VkBufferCreateInfo bufferInfo{};
-                bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-                bufferInfo.size = bufferSize;
-                bufferInfo.usage = usageFlags;
-                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-                if (vkCreateBuffer(device.GetDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-                    throw std::runtime_error("Failed to create buffer.");
-                }
-
-                VkMemoryRequirements memRequirements;
-                vkGetBufferMemoryRequirements(device.GetDevice(), buffer, &memRequirements);
-
-                VkMemoryAllocateInfo allocInfo{};
-                allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                allocInfo.allocationSize = memRequirements.size;
-                allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, mpf);
-
-                if (vkAllocateMemory(device.GetDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-                    throw std::runtime_error("Failed to allocate buffer memory.");
-                }
-
-                vkBindBufferMemory(device.GetDevice(), buffer, memory, 0);
+            std::shared_ptr<Buffer> CreateBuffer(VkDeviceSize& instanceSize, uint32_t& instanceCount, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment = 1) {
+                std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>(device, allocator, instanceSize, instanceCount, usageFlags, memoryPropertyFlags, minOffsetAlignment);
+                return buffer;
             }
 
-            ~Buffer() {
-                Unmap();
-                vkDestroyBuffer(device.GetDevice(), buffer, nullptr);
-                vkFreeMemory(device.GetDevice(), memory, nullptr);
+            std::shared_ptr<Image> CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+                auto image = std::make_shared<Image>(device, allocator, width, height, format, usage, aspect, memoryPropertyFlags);
+                std::lock_guard<std::mutex> lock(imagesMutex);
+                images.push_back(image);
+                return image;
             }
 
-            VkResult Map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
-                VkResult result = vkMapMemory(device.GetDevice(), memory, offset, size, 0, &mapped);
-                return result;
-            }
-            
-            void Unmap() {
-                if (mapped) {
-                    vkUnmapMemory(device.GetDevice(), memory);
-                    mapped = nullptr;
-                }
-            }
+            // Destroys every pooled buffer and every image that is still alive, for shutdown while meshes or
+            // snapshots may still hold references. Those references stay valid objects, just empty ones.
+            void DestroyAll() {
+                // Nothing may still be copying into the buffers about to go.
+                uploader.Stop();
 
-            void WriteToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
-                if (!mapped) {
-                    throw std::runtime_error("Cannot copy to unmapped buffer.");
+                for (auto& buffer : buffer_pool) {
+                    buffer->Destroy();
                 }
+                buffer_pool.clear();
 
-                if (size == VK_WHOLE_SIZE) {
-                    memcpy(mapped, data, bufferSize);
-                }
-                else {
-                    char* memOffset = (char*)mapped;
-                    memOffset += offset;
-                    memcpy(memOffset, data, size);
+                std::lock_guard<std::mutex> lock(imagesMutex);
+                for (auto& weak : images) {
+                    if (auto image = weak.lock()) {
+                        image->Destroy();
+                    }
                 }
+                images.clear();
             }
 
-            VkResult Flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
-                VkMappedMemoryRange mappedRange = {};
-                mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-                mappedRange.memory = memory;
-                mappedRange.offset = offset;
-                mappedRange.size = size;
-                return vkFlushMappedMemoryRanges(device.GetDevice(), 1, &mappedRange);
-            }
-
-            VkResult Invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
-                VkMappedMemoryRange mappedRange = {};
-                mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-                mappedRange.memory = memory;
-                mappedRange.offset = offset;
-                mappedRange.size = size;
-                return vkInvalidateMappedMemoryRanges(device.GetDevice(), 1, &mappedRange);
-            }
-
-            VkBuffer& GetBuffer() {
-                return buffer;
-            }
-
-            VkDeviceMemory& GetBufferMemory() {
-                return memory;
-            }
-
-            uint32_t& GetInstanceCount() {
-                return instanceCount;
-            }
-
-            VkDeviceSize& GetInstanceSize() {
-                return instanceSize;
-            }
-
-            VkDeviceSize& GetAlignmentSize() {
-                return alignmentSize;
+            MemoryAllocator& GetAllocator() {
+                return allocator;
             }
 
-            VkDeviceSize& GetBufferSize() {
-                return bufferSize;
+            void AddBufferToBufferPool(std::shared_ptr<Buffer> buffer) {
+                buffer_pool.push_back(buffer);
             }
 
-        private:
-            Device& device;
-
-            void* mapped = nullptr;
-            VkBuffer buffer = VK_NULL_HANDLE;
-            VkDeviceMemory memory = VK_NULL_HANDLE;
-
-            VkDeviceSize bufferSize;
-            uint32_t instanceCount;
-            VkDeviceSize instanceSize;
-            VkDeviceSize alignmentSize;
-            VkBufferUsageFlags usageFlags;
-            VkMemoryPropertyFlags memoryPropertyFlags;
-
-            // Only if buffer is vertex or index buffer
-            std::shared_ptr<std::vector<Vertex2D>> vertices2D;
-            std::shared_ptr<std::vector<Vertex3D>> vertices3D;
-            std::shared_ptr<std::vector<uint32_t>> indices;
-
-    };
-    class BufferManager {
-        public:
-            BufferManager(Device& d, CommandPool& c) : device{d}, command_pool{c} {
-
+            // Queues data for upload into dst on the upload thread, see Uploader::Upload.
+            void Upload(const void* data, VkDeviceSize size, std::shared_ptr<Buffer> dst, VkDeviceSize dstOffset = 0, std::function<void()> onResident = {}) {
+                uploader.Upload(data, size, std::move(dst), dstOffset, std::move(onResident));
             }
 
-            std::shared_ptr<Buffer> CreateBuffer(VkDeviceSize& instanceSize, uint32_t& instanceCount, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment = 1) {
-                std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>(device, instanceSize, instanceCount, usageFlags, memoryPropertyFlags, minOffsetAlignment);
-                return buffer;
+            // Hands every upload that finished since the last frame over to the graphics queue, see
+            // Uploader::RecordAcquires. Call outside a render pass.
+            void RecordUploads(VkCommandBuffer commandBuffer, FrameResources& frame) {
+                uploader.RecordAcquires(commandBuffer, frame);
             }
 
-            void AddBufferToBufferPool(std::shared_ptr<Buffer> buffer) {
-                buffer_pool.push_back(buffer);
+            Uploader& GetUploader() {
+                return uploader;
             }
 
             void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0) {
@@ -197,47 +105,10 @@ namespace vkr {
                 command_pool.EndSingleTimeCommands(commandBuffer);
             }
 
-            std::shared_ptr<Buffer> CreateVertexBuffer(const std::vector<Vertex3D>& vertices) {
-                uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
-                if (vertexCount < 3) {
-                    throw std::runtime_error("Vertex count must be atleast 3.");
-                }
-                VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-                VkDeviceSize vertexSize = sizeof(vertices[0]);
-
-                std::shared_ptr<Buffer> stagingBuffer = CreateBuffer(vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-                stagingBuffer->Map();
-                stagingBuffer->WriteToBuffer((void*)vertices.data());
-
-                std::shared_ptr<Buffer> vertexBuffer = CreateBuffer(vertexSize, vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-                CopyBuffer(stagingBuffer->GetBuffer(), vertexBuffer->GetBuffer(), bufferSize);
-
-                AddBufferToBufferPool(vertexBuffer);
-
-                return vertexBuffer;
-            }
-            std::shared_ptr<Buffer> CreateVertexBuffer(const std::vector<Vertex2D>& vertices) {
-                uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
-                if (vertexCount < 3) {
-                    throw std::runtime_error("Vertex count must be atleast 3.");
-                }
-                VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-                VkDeviceSize vertexSize = sizeof(vertices[0]);
-
-                std::shared_ptr<Buffer> stagingBuffer = CreateBuffer(vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-                stagingBuffer->Map();
-                stagingBuffer->WriteToBuffer((void*)vertices.data());
-
-                std::shared_ptr<Buffer> vertexBuffer = CreateBuffer(vertexSize, vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-                CopyBuffer(stagingBuffer->GetBuffer(), vertexBuffer->GetBuffer(), bufferSize);
-
-                AddBufferToBufferPool(vertexBuffer);
-
-                return vertexBuffer;
+            // Indices that fit in 16 bits are stored as uint16, halving the index data and the index fetch bandwidth.
+            // 0xFFFF is left out of the 16-bit range since it is the primitive restart value.
+            static VkIndexType SelectIndexType(size_t vertexCount) {
+                return vertexCount <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
             }
 
             std::vector<std::shared_ptr<Buffer>>& GetBufferPool() {
@@ -246,7 +117,11 @@ namespace vkr {
         private:
             Device& device;
             CommandPool& command_pool;
+            MemoryAllocator& allocator;
+            Uploader uploader;
 
             std::vector<std::shared_ptr<Buffer>> buffer_pool;
+            std::vector<std::weak_ptr<Image>> images;
+            std::mutex imagesMutex;
     };
 }
\ No newline at end of file
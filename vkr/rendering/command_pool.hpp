@@ -1,5 +1,8 @@
 #pragma once
 
+// std
+#include <mutex>
+
 namespace vkr {
     class CommandPool {
         public:
@@ -11,6 +14,7 @@ namespace vkr {
             ~CommandPool() {
                 FreeCommandBuffers();
                 vkDestroyCommandPool(device.GetDevice(), commandPool, nullptr);
+                vkDestroyCommandPool(device.GetDevice(), uploadPool, nullptr);
             }
 
             void CreateCommandPool() {
@@ -24,6 +28,13 @@ namespace vkr {
                 if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to create command pool.");
                 }
+
+                // Single time commands come from any thread, so they get their own pool instead of sharing the
+                // one the render loop records into every frame.
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &uploadPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create upload command pool.");
+                }
             }
 
             void CreateCommandBuffers() {
@@ -40,11 +51,14 @@ namespace vkr {
                 }
             }
 
+            // Holds the upload pool until the matching EndSingleTimeCommands.
             VkCommandBuffer BeginSingleTimeCommands() {
+                uploadMutex.lock();
+
                 VkCommandBufferAllocateInfo allocInfo{};
                 allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
                 allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-                allocInfo.commandPool = commandPool;
+                allocInfo.commandPool = uploadPool;
                 allocInfo.commandBufferCount = 1;
 
                 VkCommandBuffer commandBuffer;
@@ -66,10 +80,14 @@ namespace vkr {
                 submitInfo.commandBufferCount = 1;
                 submitInfo.pCommandBuffers = &commandBuffer;
 
-                vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-                vkQueueWaitIdle(device.GetGraphicsQueue());
+                {
+                    std::lock_guard<std::mutex> lock(device.GetQueueMutex());
+                    vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+                    vkQueueWaitIdle(device.GetGraphicsQueue());
+                }
 
-                vkFreeCommandBuffers(device.GetDevice(), commandPool, 1, &commandBuffer);
+                vkFreeCommandBuffers(device.GetDevice(), uploadPool, 1, &commandBuffer);
+                uploadMutex.unlock();
             }
 
             void FreeCommandBuffers() {
@@ -86,6 +104,8 @@ namespace vkr {
             Swapchain& swapchain;
 
             VkCommandPool commandPool;
+            VkCommandPool uploadPool;
+            std::mutex uploadMutex;
 
             std::vector<VkCommandBuffer> commandBuffers;
     };
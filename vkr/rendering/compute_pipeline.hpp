@@ -0,0 +1,36 @@
+#pragma once
+
+namespace vkr {
+    class ComputePipeline {
+        public:
+            // Like Pipeline the module belongs to the caller, PipelineLibrary creates these on its compile threads.
+            ComputePipeline(Device& d, VkPipelineLayout layout, VkShaderModule shaderModule) : device{d} {
+                VkComputePipelineCreateInfo pipelineInfo{};
+                pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module = shaderModule;
+                pipelineInfo.stage.pName = "main";
+                pipelineInfo.layout = layout;
+
+                if (vkCreateComputePipelines(device.GetDevice(), device.GetPipelineCache().GetCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create compute pipeline.");
+                }
+            }
+
+            ~ComputePipeline() {
+                vkDestroyPipeline(device.GetDevice(), pipeline, nullptr);
+            }
+
+            ComputePipeline(const ComputePipeline&) = delete;
+            ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+            VkPipeline GetPipeline() const {
+                return pipeline;
+            }
+
+        private:
+            Device& device;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+    };
+}
@@ -6,6 +6,9 @@
 #include <stdexcept>
 #include <optional>
 #include <set>
+#include <mutex>
+#include <cstring>
+#include <memory>
 
 namespace vkr {
     class Device {
@@ -16,6 +19,7 @@ namespace vkr {
             }
 
             ~Device() {
+                pipelineCache.reset();
                 vkDestroyDevice(device, nullptr);
             }
 
@@ -77,6 +81,8 @@ namespace vkr {
             struct QueueFamilyIndices {
                 std::optional<uint32_t> graphicsFamily;
                 std::optional<uint32_t> presentFamily;
+                // Transfer-only family, usually backed by a DMA engine. Empty when the device has none.
+                std::optional<uint32_t> transferFamily;
 
                 bool isComplete() {
                     return graphicsFamily.has_value() && presentFamily.has_value();
@@ -122,21 +128,26 @@ namespace vkr {
                 std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
                 vkGetPhysicalDeviceQueueFamilyProperties(d, &queueFamilyCount, queueFamilies.data());
 
-                int i = 0;
+                uint32_t i = 0;
                 for (const auto& queueFamily : queueFamilies) {
-                    if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                    if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
                         indices.graphicsFamily = i;
                     }
 
                     VkBool32 presentSupport = false;
                     vkGetPhysicalDeviceSurfaceSupportKHR(d, i, surface.GetSurface(), &presentSupport);
 
-                    if (presentSupport) {
+                    if (presentSupport && !indices.presentFamily.has_value()) {
                         indices.presentFamily = i;
                     }
 
-                    if (indices.isComplete()) {
-                        break;
+                    // Prefer a pure transfer family over one that can also do compute.
+                    if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                        bool better = !indices.transferFamily.has_value() ||
+                            ((queueFamilies[indices.transferFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT));
+                        if (better) {
+                            indices.transferFamily = i;
+                        }
                     }
 
                     i++;
@@ -150,6 +161,9 @@ namespace vkr {
 
                 std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
                 std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+                if (indices.transferFamily.has_value()) {
+                    uniqueQueueFamilies.insert(indices.transferFamily.value());
+                }
 
                 float queuePriority = 1.0f;
                 for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -161,7 +175,19 @@ namespace vkr {
                     queueCreateInfos.push_back(queueCreateInfo);
                 }
 
+                // Optional features and extensions are turned on when the device has them, code using them checks
+                // the matching Has* accessor and falls back otherwise.
+                VkPhysicalDeviceFeatures supportedFeatures{};
+                vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
                 VkPhysicalDeviceFeatures deviceFeatures{};
+                deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+                multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+                std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+                drawIndirectCount = IsExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+                if (drawIndirectCount) {
+                    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+                }
 
                 VkDeviceCreateInfo createInfo{};
                 createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -169,8 +195,8 @@ namespace vkr {
                 createInfo.pQueueCreateInfos = queueCreateInfos.data();
                 createInfo.pEnabledFeatures = &deviceFeatures;
 
-                createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-                createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+                createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+                createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
                 if (validationLayers.ValidationLayersSupport()) {
                     createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.GetValidationLayers().size());
@@ -185,6 +211,43 @@ namespace vkr {
 
                 vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
                 vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+                // Without a transfer family, uploads share the graphics queue and its lock.
+                if (indices.transferFamily.has_value()) {
+                    vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+                }
+                else {
+                    transferQueue = graphicsQueue;
+                }
+                queueFamilies = indices;
+
+                if (drawIndirectCount) {
+                    cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+                    drawIndirectCount = cmdDrawIndexedIndirectCount != nullptr;
+                }
+
+                uint32_t queueFamilyCount = 0;
+                vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+                std::vector<VkQueueFamilyProperties> properties(queueFamilyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, properties.data());
+                graphicsCompute = (properties[indices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+
+                pipelineCache = std::make_unique<PipelineCache>(device, physicalDevice);
+            }
+
+            bool IsExtensionSupported(VkPhysicalDevice d, const char* name) {
+                uint32_t extensionCount;
+                vkEnumerateDeviceExtensionProperties(d, nullptr, &extensionCount, nullptr);
+
+                std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+                vkEnumerateDeviceExtensionProperties(d, nullptr, &extensionCount, availableExtensions.data());
+
+                for (const auto& extension : availableExtensions) {
+                    if (strcmp(extension.extensionName, name) == 0) {
+                        return true;
+                    }
+                }
+                return false;
             }
 
             VkPhysicalDevice& GetPhysicalDevice() {
@@ -203,6 +266,55 @@ namespace vkr {
                 return presentQueue;
             }
 
+            // Queues are externally synchronised, hold this around every submit and present.
+            std::mutex& GetQueueMutex() {
+                return queueMutex;
+            }
+
+            VkQueue& GetTransferQueue() {
+                return transferQueue;
+            }
+
+            std::mutex& GetTransferQueueMutex() {
+                return HasDedicatedTransferQueue() ? transferQueueMutex : queueMutex;
+            }
+
+            bool HasDedicatedTransferQueue() const {
+                return queueFamilies.transferFamily.has_value();
+            }
+
+            // Family uploads are recorded for, the graphics family when there is no dedicated transfer family.
+            uint32_t GetTransferFamily() const {
+                return queueFamilies.transferFamily.value_or(queueFamilies.graphicsFamily.value());
+            }
+
+            uint32_t GetGraphicsFamily() const {
+                return queueFamilies.graphicsFamily.value();
+            }
+
+            // Compute dispatches can be recorded into the frame's command buffer.
+            bool HasGraphicsCompute() const {
+                return graphicsCompute;
+            }
+
+            bool HasMultiDrawIndirect() const {
+                return multiDrawIndirect;
+            }
+
+            // VK_KHR_draw_indirect_count, recorded through CmdDrawIndexedIndirectCount.
+            bool HasDrawIndirectCount() const {
+                return drawIndirectCount;
+            }
+
+            // Shared by every pipeline created on this device.
+            PipelineCache& GetPipelineCache() {
+                return *pipelineCache;
+            }
+
+            void CmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride) {
+                cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+            }
+
         private:
             Window& window;
             ValidationLayers& validationLayers;
@@ -213,6 +325,16 @@ namespace vkr {
             VkDevice device;
             VkQueue graphicsQueue;
             VkQueue presentQueue;
+            VkQueue transferQueue;
+            std::mutex queueMutex;
+            std::mutex transferQueueMutex;
+            QueueFamilyIndices queueFamilies;
+
+            bool graphicsCompute = false;
+            bool multiDrawIndirect = false;
+            bool drawIndirectCount = false;
+            PFN_vkCmdDrawIndexedIndirectCount cmdDrawIndexedIndirectCount = nullptr;
+            std::unique_ptr<PipelineCache> pipelineCache;
 
             const std::vector<const char*> deviceExtensions = {
                 VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -0,0 +1,37 @@
+#pragma once
+
+// std
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace vkr {
+    // Things one frame in flight still needs on the GPU. They are released only once that frame's fence has
+    // signalled, the next time the same frame slot comes round, so the CPU can move on to the next frame without
+    // destroying or overwriting anything the GPU is still reading.
+    class FrameResources {
+        public:
+            // Keeps resource alive until the frame has finished on the GPU.
+            void Retain(std::shared_ptr<void> resource) {
+                retained.push_back(std::move(resource));
+            }
+
+            // Runs destroy once the frame has finished on the GPU.
+            void DeferDestroy(std::function<void()> destroy) {
+                deletions.push_back(std::move(destroy));
+            }
+
+            // Only call after the frame's fence has signalled.
+            void Release() {
+                for (auto& destroy : deletions) {
+                    destroy();
+                }
+                deletions.clear();
+                retained.clear();
+            }
+
+        private:
+            std::vector<std::shared_ptr<void>> retained;
+            std::vector<std::function<void()>> deletions;
+    };
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace vkr {
+    struct FrameStats {
+        // Time between the start of this frame and the start of the previous one.
+        double frameMilliseconds = 0.0;
+        // Time the CPU spent blocked on the frame slot's fence, waiting for the GPU to catch up.
+        double fenceWaitMilliseconds = 0.0;
+        // Time the CPU spent on the frame, everything except the fence wait.
+        double cpuMilliseconds = 0.0;
+        // GPU execution time of the last frame that finished in this slot, 0 if timestamps are unsupported.
+        double gpuMilliseconds = 0.0;
+        // How much of the shorter of CPU and GPU work was hidden behind the other. 0 means they ran in lockstep
+        // (frame = cpu + gpu), 1 means fully pipelined (frame = max(cpu, gpu)).
+        double overlap = 0.0;
+        // Time from reading input to submitting the frame built from it. Frames queued ahead of it and the wait for
+        // scan-out come on top, which is what frames in flight and the present mode change.
+        double inputToSubmitMilliseconds = 0.0;
+
+        void ComputeOverlap() {
+            double shorter = std::min(cpuMilliseconds, gpuMilliseconds);
+            if (shorter <= 0.0) {
+                overlap = 0.0;
+                return;
+            }
+            overlap = std::clamp((cpuMilliseconds + gpuMilliseconds - frameMilliseconds) / shorter, 0.0, 1.0);
+        }
+    };
+
+    // Sums FrameStats over a run of frames, single frames are too noisy to compare present policies by.
+    struct FrameStatsAverage {
+        FrameStats sum;
+        uint32_t count = 0;
+
+        void Add(const FrameStats& stats) {
+            sum.frameMilliseconds += stats.frameMilliseconds;
+            sum.fenceWaitMilliseconds += stats.fenceWaitMilliseconds;
+            sum.cpuMilliseconds += stats.cpuMilliseconds;
+            sum.gpuMilliseconds += stats.gpuMilliseconds;
+            sum.overlap += stats.overlap;
+            sum.inputToSubmitMilliseconds += stats.inputToSubmitMilliseconds;
+            count++;
+        }
+
+        FrameStats Get() const {
+            FrameStats average;
+            if (count == 0) {
+                return average;
+            }
+            average.frameMilliseconds = sum.frameMilliseconds / count;
+            average.fenceWaitMilliseconds = sum.fenceWaitMilliseconds / count;
+            average.cpuMilliseconds = sum.cpuMilliseconds / count;
+            average.gpuMilliseconds = sum.gpuMilliseconds / count;
+            average.overlap = sum.overlap / count;
+            average.inputToSubmitMilliseconds = sum.inputToSubmitMilliseconds / count;
+            return average;
+        }
+
+        void Reset() {
+            *this = {};
+        }
+    };
+
+    // Brackets each frame's command buffer with timestamps, two queries per frame in flight. Results are read back
+    // once the slot's fence has signalled, so reading never stalls.
+    class GpuTimer {
+        public:
+            GpuTimer(Device& d, uint32_t framesInFlight) : device{d}, written(framesInFlight, false) {
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(device.GetPhysicalDevice(), &properties);
+                timestampPeriod = properties.limits.timestampPeriod;
+                supported = properties.limits.timestampComputeAndGraphics == VK_TRUE && timestampPeriod > 0.0f;
+                if (!supported) {
+                    return;
+                }
+
+                VkQueryPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                poolInfo.queryCount = framesInFlight * 2;
+
+                if (vkCreateQueryPool(device.GetDevice(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create timestamp query pool.");
+                }
+            }
+
+            ~GpuTimer() {
+                if (queryPool != VK_NULL_HANDLE) {
+                    vkDestroyQueryPool(device.GetDevice(), queryPool, nullptr);
+                }
+            }
+
+            GpuTimer(const GpuTimer&) = delete;
+            GpuTimer& operator=(const GpuTimer&) = delete;
+
+            void Begin(VkCommandBuffer commandBuffer, uint32_t frame) {
+                if (!supported) {
+                    return;
+                }
+                vkCmdResetQueryPool(commandBuffer, queryPool, frame * 2, 2);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frame * 2);
+            }
+
+            void End(VkCommandBuffer commandBuffer, uint32_t frame) {
+                if (!supported) {
+                    return;
+                }
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frame * 2 + 1);
+                written[frame] = true;
+            }
+
+            // GPU time of the last frame recorded into this slot. Only call after the slot's fence has signalled.
+            double Collect(uint32_t frame) {
+                if (!supported || !written[frame]) {
+                    return 0.0;
+                }
+                uint64_t timestamps[2] = {};
+                if (vkGetQueryPoolResults(device.GetDevice(), queryPool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+                    return 0.0;
+                }
+                return double(timestamps[1] - timestamps[0]) * timestampPeriod / 1e6;
+            }
+
+        private:
+            Device& device;
+
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            float timestampPeriod = 0.0f;
+            bool supported = false;
+            std::vector<bool> written;
+    };
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include "compute_pipeline.hpp"
+#include "pipeline_library.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vkr {
+    // Culls instances against the camera frustum on the GPU and draws the survivors indirectly, so the CPU records
+    // the same few commands however many instances there are. The first compute pass tests every instance's
+    // bounding sphere and compacts the visible ones per mesh. The second turns every mesh with visible instances
+    // into a VkDrawIndexedIndirectCommand and counts them, and draws sharing buffers become one
+    // vkCmdDrawIndexedIndirectCount.
+    //
+    // Without VK_KHR_draw_indirect_count every mesh keeps its command slot, culled meshes draw zero instances and
+    // the commands go through vkCmdDrawIndexedIndirect, one call each without multiDrawIndirect. Lavapipe has both,
+    // allowDrawIndirectCount false takes the fallback anyway.
+    class GpuCuller {
+        public:
+            static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+            // The compute pipelines come from pipelineLibrary's compile threads, Record does nothing until both are in.
+            GpuCuller(Device& d, BufferManager& bm, PipelineLibrary& pipelineLibrary, uint32_t framesInFlight, const std::string& cullShaderPath, const std::string& emitShaderPath, bool allowDrawIndirectCount = true) : device{d}, bufferManager{bm}, frames(framesInFlight), drawIndirectCount{allowDrawIndirectCount && d.HasDrawIndirectCount()} {
+                if (!device.HasGraphicsCompute()) {
+                    throw std::runtime_error("GPU culling needs a graphics queue that supports compute.");
+                }
+
+                ComputeLayout layout = pipelineLibrary.GetComputeLayout(BINDING_COUNT, sizeof(PushConstants));
+                setLayout = layout.setLayout;
+                pipelineLayout = layout.pipelineLayout;
+                cullPipeline = pipelineLibrary.GetComputePipeline(cullShaderPath, BINDING_COUNT, sizeof(PushConstants));
+                emitPipeline = pipelineLibrary.GetComputePipeline(emitShaderPath, BINDING_COUNT, sizeof(PushConstants));
+
+                VkDescriptorPoolSize poolSize{};
+                poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                poolSize.descriptorCount = BINDING_COUNT * framesInFlight;
+                VkDescriptorPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.maxSets = framesInFlight;
+                poolInfo.poolSizeCount = 1;
+                poolInfo.pPoolSizes = &poolSize;
+                if (vkCreateDescriptorPool(device.GetDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create culling descriptor pool.");
+                }
+
+                std::vector<VkDescriptorSetLayout> setLayouts(framesInFlight, setLayout);
+                std::vector<VkDescriptorSet> sets(framesInFlight);
+                VkDescriptorSetAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                allocInfo.descriptorPool = descriptorPool;
+                allocInfo.descriptorSetCount = framesInFlight;
+                allocInfo.pSetLayouts = setLayouts.data();
+                if (vkAllocateDescriptorSets(device.GetDevice(), &allocInfo, sets.data()) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate culling descriptor sets.");
+                }
+                for (uint32_t f = 0; f < framesInFlight; f++) {
+                    frames[f].descriptorSet = sets[f];
+                }
+            }
+
+            ~GpuCuller() {
+                cullPipeline.reset();
+                emitPipeline.reset();
+                vkDestroyDescriptorPool(device.GetDevice(), descriptorPool, nullptr);
+            }
+
+            GpuCuller(const GpuCuller&) = delete;
+            GpuCuller& operator=(const GpuCuller&) = delete;
+
+            // Records both culling passes for draws, whose instances are read from instanceBuffer. Call outside a
+            // render pass, once the frame slot's fence has signalled. The CPU work is per mesh, not per instance.
+            void Record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer instanceBuffer, const std::vector<RenderSnapshot::Draw>& draws, const qbn::mat<float, 4>& viewProjection) {
+                FrameSlot& slot = frames[frameIndex];
+                slot.groups.clear();
+                if (draws.empty() || !cullPipeline->IsReady() || !emitPipeline->IsReady()) {
+                    return;
+                }
+
+                batches.clear();
+                uint32_t objectBase = UINT32_MAX;
+                uint32_t objectEnd = 0;
+                for (uint32_t i = 0; i < draws.size(); i++) {
+                    auto& draw = draws[i];
+                    // Draws come sorted by buffer, so every group is one run of commands.
+                    if (slot.groups.empty() || slot.groups.back().vertexBuffer != draw.vertexBuffer || slot.groups.back().indexBuffer != draw.indexBuffer) {
+                        slot.groups.push_back({draw.vertexBuffer, draw.indexBuffer, draw.indexType, i, 0});
+                    }
+                    auto& group = slot.groups.back();
+                    group.commandCount++;
+
+                    CullBatch batch{};
+                    batch.sphere = draw.mesh->GetBoundingSphere();
+                    batch.indexCount = draw.indexCount;
+                    batch.firstIndex = draw.firstIndex;
+                    batch.vertexOffset = draw.vertexOffset;
+                    batch.firstInstance = draw.firstInstance;
+                    batch.instanceCount = draw.instanceCount;
+                    batch.group = static_cast<uint32_t>(slot.groups.size() - 1);
+                    batch.commandIndex = i;
+                    batch.commandBase = group.firstCommand;
+                    batches.push_back(batch);
+
+                    objectBase = std::min(objectBase, draw.firstInstance);
+                    objectEnd = std::max(objectEnd, draw.firstInstance + draw.instanceCount);
+                }
+                // The shader finds an instance's batch by binary search over firstInstance.
+                std::sort(batches.begin(), batches.end(), [](const CullBatch& a, const CullBatch& b) { return a.firstInstance < b.firstInstance; });
+
+                const uint32_t batchCount = static_cast<uint32_t>(batches.size());
+                const uint32_t objectCount = objectEnd - objectBase;
+                Reserve(slot.batches, batchCount, sizeof(CullBatch), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                Reserve(slot.batchCounts, batchCount, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                Reserve(slot.visible, objectCount, sizeof(InstanceData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                Reserve(slot.commands, batchCount, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                Reserve(slot.drawCounts, static_cast<uint32_t>(slot.groups.size()), sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                slot.batches->WriteToBuffer(batches.data(), sizeof(CullBatch) * batchCount);
+
+                UpdateDescriptorSet(slot, instanceBuffer);
+
+                vkCmdFillBuffer(commandBuffer, slot.batchCounts->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+                vkCmdFillBuffer(commandBuffer, slot.drawCounts->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+                Barrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+                PushConstants constants{};
+                ExtractFrustumPlanes(viewProjection, constants.planes);
+                constants.objectBase = objectBase;
+                constants.objectCount = objectCount;
+                constants.batchCount = batchCount;
+                constants.compact = drawIndirectCount ? 1 : 0;
+
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &slot.descriptorSet, 0, nullptr);
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->GetPipeline()->GetPipeline());
+                vkCmdDispatch(commandBuffer, (objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+                Barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline->GetPipeline()->GetPipeline());
+                vkCmdDispatch(commandBuffer, (batchCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+                Barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            }
+
+            // Draws what Record left visible, inside the render pass with the graphics pipeline bound.
+            void Draw(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+                FrameSlot& slot = frames[frameIndex];
+                if (slot.groups.empty()) {
+                    return;
+                }
+
+                VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(commandBuffer, 1, 1, &slot.visible->GetBuffer(), &offset);
+
+                const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+                for (uint32_t g = 0; g < slot.groups.size(); g++) {
+                    auto& group = slot.groups[g];
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &group.vertexBuffer, &offset);
+                    vkCmdBindIndexBuffer(commandBuffer, group.indexBuffer, 0, group.indexType);
+
+                    VkDeviceSize commandOffset = VkDeviceSize(group.firstCommand) * stride;
+                    if (drawIndirectCount) {
+                        device.CmdDrawIndexedIndirectCount(commandBuffer, slot.commands->GetBuffer(), commandOffset, slot.drawCounts->GetBuffer(), VkDeviceSize(g) * sizeof(uint32_t), group.commandCount, stride);
+                    }
+                    else if (device.HasMultiDrawIndirect()) {
+                        vkCmdDrawIndexedIndirect(commandBuffer, slot.commands->GetBuffer(), commandOffset, group.commandCount, stride);
+                    }
+                    else {
+                        for (uint32_t c = 0; c < group.commandCount; c++) {
+                            vkCmdDrawIndexedIndirect(commandBuffer, slot.commands->GetBuffer(), commandOffset + VkDeviceSize(c) * stride, 1, stride);
+                        }
+                    }
+                }
+            }
+
+            // False on the fallback path, see the class comment.
+            bool UsesDrawIndirectCount() const {
+                return drawIndirectCount;
+            }
+
+            // Planes of the view-projection's clip volume as (normal, distance), normals pointing inwards. Vulkan
+            // clip space, depth from 0 to w.
+            static void ExtractFrustumPlanes(const qbn::mat<float, 4>& m, float planes[6][4]) {
+                auto row = [&m](int r, int c) { return m[c][r]; };
+                for (int c = 0; c < 4; c++) {
+                    planes[0][c] = row(3, c) + row(0, c);
+                    planes[1][c] = row(3, c) - row(0, c);
+                    planes[2][c] = row(3, c) + row(1, c);
+                    planes[3][c] = row(3, c) - row(1, c);
+                    planes[4][c] = row(2, c);
+                    planes[5][c] = row(3, c) - row(2, c);
+                }
+                for (int p = 0; p < 6; p++) {
+                    float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+                    if (length > 0.0f) {
+                        for (int c = 0; c < 4; c++) {
+                            planes[p][c] /= length;
+                        }
+                    }
+                }
+            }
+
+        private:
+            static constexpr uint32_t BINDING_COUNT = 6;
+
+            // Batch in the culling shaders, std430.
+            struct CullBatch {
+                qbn::vec<float, 4> sphere;
+                uint32_t indexCount;
+                uint32_t firstIndex;
+                int32_t vertexOffset;
+                uint32_t firstInstance;
+                uint32_t instanceCount;
+                uint32_t group;
+                uint32_t commandIndex;
+                uint32_t commandBase;
+            };
+
+            struct PushConstants {
+                float planes[6][4];
+                uint32_t objectBase;
+                uint32_t objectCount;
+                uint32_t batchCount;
+                uint32_t compact;
+            };
+
+            // Draws sharing vertex and index buffers, one indirect call.
+            struct Group {
+                VkBuffer vertexBuffer;
+                VkBuffer indexBuffer;
+                VkIndexType indexType;
+                uint32_t firstCommand;
+                uint32_t commandCount;
+            };
+
+            struct FrameSlot {
+                VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+                std::shared_ptr<Buffer> batches;
+                std::shared_ptr<Buffer> batchCounts;
+                std::shared_ptr<Buffer> visible;
+                std::shared_ptr<Buffer> commands;
+                std::shared_ptr<Buffer> drawCounts;
+                std::vector<Group> groups;
+            };
+
+            Device& device;
+            BufferManager& bufferManager;
+
+            // Both owned by the PipelineLibrary.
+            VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+            VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            std::shared_ptr<ComputePipelineHandle> cullPipeline;
+            std::shared_ptr<ComputePipelineHandle> emitPipeline;
+
+            std::vector<FrameSlot> frames;
+            std::vector<CullBatch> batches;
+            bool drawIndirectCount;
+
+            // Grows buffer to the next power of two that holds count elements. The slot's last frame has finished,
+            // so the old buffer can go straight away.
+            void Reserve(std::shared_ptr<Buffer>& buffer, uint32_t count, VkDeviceSize elementSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+                if (buffer && buffer->GetInstanceCount() >= count) {
+                    return;
+                }
+                uint32_t capacity = 64;
+                while (capacity < count) {
+                    capacity *= 2;
+                }
+                buffer = bufferManager.CreateBuffer(elementSize, capacity, usage, properties);
+                if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                    buffer->Map();
+                }
+            }
+
+            void UpdateDescriptorSet(FrameSlot& slot, VkBuffer instanceBuffer) {
+                VkBuffer buffers[BINDING_COUNT] = {
+                    instanceBuffer,
+                    slot.batches->GetBuffer(),
+                    slot.batchCounts->GetBuffer(),
+                    slot.visible->GetBuffer(),
+                    slot.commands->GetBuffer(),
+                    slot.drawCounts->GetBuffer()
+                };
+
+                VkDescriptorBufferInfo bufferInfos[BINDING_COUNT];
+                VkWriteDescriptorSet writes[BINDING_COUNT];
+                for (uint32_t b = 0; b < BINDING_COUNT; b++) {
+                    bufferInfos[b] = {buffers[b], 0, VK_WHOLE_SIZE};
+                    writes[b] = {};
+                    writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    writes[b].dstSet = slot.descriptorSet;
+                    writes[b].dstBinding = b;
+                    writes[b].descriptorCount = 1;
+                    writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    writes[b].pBufferInfo = &bufferInfos[b];
+                }
+                vkUpdateDescriptorSets(device.GetDevice(), BINDING_COUNT, writes, 0, nullptr);
+            }
+
+            static void Barrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+                VkMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = dstAccess;
+                vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            }
+    };
+}
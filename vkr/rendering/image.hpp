@@ -0,0 +1,98 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+
+// std
+#include <stdexcept>
+
+namespace vkr {
+    // Optimally tiled 2D image with a view over all of it, its memory sub-allocated from MemoryAllocator.
+    class Image {
+        public:
+            Image(Device& d, MemoryAllocator& a, uint32_t width, uint32_t height, VkFormat f, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkMemoryPropertyFlags memoryPropertyFlags, VkMemoryPropertyFlags preferredMemoryPropertyFlags = 0) : device{d}, allocator{a}, format{f}, extent{width, height} {
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.format = format;
+                imageInfo.extent = {width, height, 1};
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.usage = usage;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                if (vkCreateImage(device.GetDevice(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create image.");
+                }
+
+                allocation = allocator.AllocateForImage(image, memoryPropertyFlags, VK_IMAGE_TILING_OPTIMAL, preferredMemoryPropertyFlags);
+
+                VkImageViewCreateInfo viewInfo{};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = image;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = format;
+                viewInfo.subresourceRange.aspectMask = aspect;
+                viewInfo.subresourceRange.baseMipLevel = 0;
+                viewInfo.subresourceRange.levelCount = 1;
+                viewInfo.subresourceRange.baseArrayLayer = 0;
+                viewInfo.subresourceRange.layerCount = 1;
+
+                if (vkCreateImageView(device.GetDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create image view.");
+                }
+            }
+
+            ~Image() {
+                Destroy();
+            }
+
+            Image(const Image&) = delete;
+            Image& operator=(const Image&) = delete;
+
+            // Frees the image, its view and its memory now. Safe to call more than once.
+            void Destroy() {
+                if (image == VK_NULL_HANDLE) {
+                    return;
+                }
+                vkDestroyImageView(device.GetDevice(), imageView, nullptr);
+                vkDestroyImage(device.GetDevice(), image, nullptr);
+                allocator.Free(allocation);
+                image = VK_NULL_HANDLE;
+                imageView = VK_NULL_HANDLE;
+            }
+
+            VkImage GetImage() const {
+                return image;
+            }
+
+            VkImageView GetImageView() const {
+                return imageView;
+            }
+
+            VkFormat GetFormat() const {
+                return format;
+            }
+
+            VkExtent2D GetExtent() const {
+                return extent;
+            }
+
+            const Allocation& GetAllocation() const {
+                return allocation;
+            }
+
+        private:
+            Device& device;
+            MemoryAllocator& allocator;
+
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView imageView = VK_NULL_HANDLE;
+            Allocation allocation;
+
+            VkFormat format;
+            VkExtent2D extent;
+    };
+}
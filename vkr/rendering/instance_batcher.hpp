@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../../structs/instance.hpp"
+
+// std
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vkr {
+    // Groups instances by what they draw, so every entity sharing a mesh becomes one instanced draw. Instances are
+    // added in any order and come out contiguous per key, in the order each key was first added. Keeps its
+    // storage between frames, steady-state batching does not allocate.
+    class InstanceBatcher {
+        public:
+            struct Batch {
+                const void* key;
+                uint32_t firstInstance;
+                uint32_t instanceCount;
+            };
+
+            void Clear() {
+                batchIndices.clear();
+                batches.clear();
+                added.clear();
+            }
+
+            // Returns the index of key's batch. A new batch gets the next index, GetBatchCount() - 1.
+            uint32_t Add(const void* key, const InstanceData& instance) {
+                auto [it, inserted] = batchIndices.emplace(key, static_cast<uint32_t>(batches.size()));
+                if (inserted) {
+                    batches.push_back({key, 0, 0});
+                }
+                batches[it->second].instanceCount++;
+                added.push_back({it->second, instance});
+                return it->second;
+            }
+
+            // Appends every added instance to instances grouped by batch, and sets each batch's firstInstance to
+            // where its run starts.
+            const std::vector<Batch>& Build(std::vector<InstanceData>& instances) {
+                uint32_t next = static_cast<uint32_t>(instances.size());
+                for (auto& batch : batches) {
+                    batch.firstInstance = next;
+                    next += batch.instanceCount;
+                }
+
+                instances.resize(next);
+                cursors.resize(batches.size());
+                for (size_t b = 0; b < batches.size(); b++) {
+                    cursors[b] = batches[b].firstInstance;
+                }
+                for (auto& entry : added) {
+                    instances[cursors[entry.batch]++] = entry.instance;
+                }
+                return batches;
+            }
+
+            size_t GetBatchCount() const {
+                return batches.size();
+            }
+
+        private:
+            struct Entry {
+                uint32_t batch;
+                InstanceData instance;
+            };
+
+            std::unordered_map<const void*, uint32_t> batchIndices;
+            std::vector<Batch> batches;
+            std::vector<Entry> added;
+            std::vector<uint32_t> cursors;
+    };
+}
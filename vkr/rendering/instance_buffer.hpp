@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../../structs/instance.hpp"
+
+// std
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace vkr {
+    // Host visible, persistently mapped instance data, one buffer per frame in flight. Also bound as a storage
+    // buffer for GPU culling. A slot is only rewritten
+    // once the frame that last read it has finished on the GPU, so writes never race the draws.
+    class InstanceBuffer {
+        public:
+            static constexpr uint32_t MIN_CAPACITY = 1024;
+
+            InstanceBuffer(BufferManager& bm, uint32_t framesInFlight) : bufferManager{bm}, slots(framesInFlight), revisions(framesInFlight, 0), generations(framesInFlight, 0) {
+
+            }
+
+            // Only call after the slot's fence has signalled. Grows the slot to the next power of two when the
+            // instances do not fit, the old buffer is no longer in use by then. Nothing is copied if the slot already
+            // holds the snapshot revision, 0 always copies.
+            VkBuffer Write(uint32_t frameIndex, const std::vector<InstanceData>& instances, uint64_t revision = 0) {
+                std::shared_ptr<Buffer>& slot = slots[frameIndex];
+                uint32_t count = static_cast<uint32_t>(instances.size());
+                if (!slot || slot->GetInstanceCount() < count) {
+                    uint32_t capacity = MIN_CAPACITY;
+                    while (capacity < count) {
+                        capacity *= 2;
+                    }
+                    VkDeviceSize instanceSize = sizeof(InstanceData);
+                    slot = bufferManager.CreateBuffer(instanceSize, capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                    if (slot->Map() != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to map instance buffer.");
+                    }
+                    revisions[frameIndex] = 0;
+                    generations[frameIndex] = nextGeneration++;
+                }
+
+                if (revision != 0 && revisions[frameIndex] == revision) {
+                    return slot->GetBuffer();
+                }
+                revisions[frameIndex] = revision;
+                if (count > 0) {
+                    slot->WriteToBuffer(const_cast<InstanceData*>(instances.data()), sizeof(InstanceData) * count);
+                }
+                return slot->GetBuffer();
+            }
+
+            // Bumped every time the slot's buffer is replaced and never reused, so anything recorded against the
+            // slot can tell the buffer it bound is gone even when the new one has the same handle.
+            uint64_t GetGeneration(uint32_t frameIndex) const {
+                return generations[frameIndex];
+            }
+
+        private:
+            BufferManager& bufferManager;
+            std::vector<std::shared_ptr<Buffer>> slots;
+            // Snapshot revision each slot was last written with.
+            std::vector<uint64_t> revisions;
+            std::vector<uint64_t> generations;
+            uint64_t nextGeneration = 1;
+    };
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+namespace vkr {
+    // A range of device memory handed out by MemoryAllocator. memory and offset are what gets passed to
+    // vkBind*Memory, mapped already includes offset when the memory is host visible.
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // Size of the range actually reserved, never less than size and always a whole number of
+        // nonCoherentAtomSize, so flushing all of it is valid.
+        VkDeviceSize rangeSize = 0;
+        void* mapped = nullptr;
+        uint32_t memoryType = 0;
+
+        // Where the range came from, only meaningful to the allocator.
+        uint32_t pool = 0;
+        uint32_t block = 0;
+        uint32_t order = 0;
+        bool dedicated = false;
+
+        bool IsNull() const {
+            return memory == VK_NULL_HANDLE;
+        }
+    };
+
+    // Binary buddy allocator over one block of device memory. Every range is a power of two in size and aligned
+    // to its own size, so any alignment up to the range size comes for free.
+    class BuddyBlock {
+        public:
+            BuddyBlock(VkDeviceSize blockSize, VkDeviceSize minRangeSize) : minSize{minRangeSize} {
+                while ((minSize << maxOrder) < blockSize) {
+                    maxOrder++;
+                }
+                freeLists.resize(maxOrder + 1);
+                freeLists[maxOrder].insert(0);
+            }
+
+            bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& order) {
+                order = OrderFor(std::max(size, alignment));
+                if (order > maxOrder) {
+                    return false;
+                }
+
+                uint32_t current = order;
+                while (current <= maxOrder && freeLists[current].empty()) {
+                    current++;
+                }
+                if (current > maxOrder) {
+                    return false;
+                }
+
+                // Lowest offset first keeps live ranges packed towards the start of the block.
+                offset = *freeLists[current].begin();
+                freeLists[current].erase(freeLists[current].begin());
+                while (current > order) {
+                    current--;
+                    freeLists[current].insert(offset + (minSize << current));
+                }
+
+                used += minSize << order;
+                return true;
+            }
+
+            void Free(VkDeviceSize offset, uint32_t order) {
+                used -= minSize << order;
+                while (order < maxOrder) {
+                    VkDeviceSize buddy = offset ^ (minSize << order);
+                    auto it = freeLists[order].find(buddy);
+                    if (it == freeLists[order].end()) {
+                        break;
+                    }
+                    freeLists[order].erase(it);
+                    offset = std::min(offset, buddy);
+                    order++;
+                }
+                freeLists[order].insert(offset);
+            }
+
+            VkDeviceSize GetUsed() const {
+                return used;
+            }
+
+            bool Empty() const {
+                return used == 0;
+            }
+
+        private:
+            VkDeviceSize minSize;
+            uint32_t maxOrder = 0;
+            VkDeviceSize used = 0;
+            std::vector<std::set<VkDeviceSize>> freeLists;
+
+            uint32_t OrderFor(VkDeviceSize size) const {
+                uint32_t order = 0;
+                while ((minSize << order) < size) {
+                    order++;
+                }
+                return order;
+            }
+    };
+
+    // Takes large blocks of device memory per memory type and sub-allocates resources out of them, instead of one
+    // vkAllocateMemory per resource. Buffers and optimally tiled images never share a block, so neighbouring
+    // ranges can never violate bufferImageGranularity. Host visible blocks stay mapped for their whole lifetime.
+    // Safe to call from any thread.
+    class MemoryAllocator {
+        public:
+            enum class ResourceKind : uint32_t {
+                Linear = 0,
+                Optimal = 1,
+            };
+
+            struct HeapStats {
+                VkDeviceSize heapSize = 0;
+                // Memory taken from the driver, in blocks and dedicated allocations.
+                VkDeviceSize reservedBytes = 0;
+                // Memory handed out to resources, including buddy rounding.
+                VkDeviceSize usedBytes = 0;
+                uint32_t blockCount = 0;
+                uint32_t allocationCount = 0;
+            };
+
+            static constexpr VkDeviceSize PREFERRED_BLOCK_SIZE = 64ull * 1024 * 1024;
+            static constexpr VkDeviceSize MIN_RANGE_SIZE = 256;
+
+            MemoryAllocator(Device& d) : device{d} {
+                vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &memoryProperties);
+
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(device.GetPhysicalDevice(), &properties);
+                // Ranges are at least one atom so flushing a non-coherent range never touches a neighbour.
+                minRangeSize = std::max(MIN_RANGE_SIZE, properties.limits.nonCoherentAtomSize);
+                maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+                pools.resize(memoryProperties.memoryTypeCount * 2);
+            }
+
+            ~MemoryAllocator() {
+                for (auto& pool : pools) {
+                    for (auto& block : pool.blocks) {
+                        if (block.memory != VK_NULL_HANDLE) {
+                            vkFreeMemory(device.GetDevice(), block.memory, nullptr);
+                        }
+                    }
+                }
+            }
+
+            MemoryAllocator(const MemoryAllocator&) = delete;
+            MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+            // preferred flags are added on top of properties when some memory type has both, such as lazily
+            // allocated memory for attachments that are never stored.
+            Allocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind, VkMemoryPropertyFlags preferred = 0) {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties, preferred);
+                uint32_t poolIndex = memoryType * 2 + static_cast<uint32_t>(kind);
+                auto& pool = pools[poolIndex];
+                VkDeviceSize blockSize = GetBlockSize(memoryType);
+
+                Allocation allocation;
+                allocation.memoryType = memoryType;
+                allocation.pool = poolIndex;
+                allocation.size = requirements.size;
+
+                // Anything bigger than half a block would waste most of one, give it its own memory instead.
+                if (requirements.size > blockSize / 2) {
+                    Block& block = CreateBlock(pool, memoryType, requirements.size, false);
+                    allocation.memory = block.memory;
+                    allocation.rangeSize = block.size;
+                    allocation.mapped = block.mapped;
+                    allocation.block = static_cast<uint32_t>(&block - pool.blocks.data());
+                    allocation.dedicated = true;
+                    return allocation;
+                }
+
+                for (size_t i = 0; i < pool.blocks.size(); i++) {
+                    auto& block = pool.blocks[i];
+                    if (block.memory == VK_NULL_HANDLE || !block.buddy) {
+                        continue;
+                    }
+                    if (block.buddy->Allocate(requirements.size, requirements.alignment, allocation.offset, allocation.order)) {
+                        return Finish(allocation, block, static_cast<uint32_t>(i));
+                    }
+                }
+
+                Block& block = CreateBlock(pool, memoryType, blockSize, true);
+                if (!block.buddy->Allocate(requirements.size, requirements.alignment, allocation.offset, allocation.order)) {
+                    throw std::runtime_error("Failed to sub-allocate device memory.");
+                }
+                return Finish(allocation, block, static_cast<uint32_t>(&block - pool.blocks.data()));
+            }
+
+            void Free(Allocation& allocation) {
+                if (allocation.IsNull()) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+
+                auto& pool = pools[allocation.pool];
+                auto& block = pool.blocks[allocation.block];
+                if (allocation.dedicated) {
+                    DestroyBlock(block);
+                }
+                else {
+                    block.buddy->Free(allocation.offset, allocation.order);
+                    block.allocationCount--;
+                    // Keep one empty block around per pool so a create/destroy loop does not hit the driver.
+                    if (block.buddy->Empty() && CountLiveBlocks(pool) > 1) {
+                        DestroyBlock(block);
+                    }
+                }
+                allocation = Allocation{};
+            }
+
+            Allocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties) {
+                VkMemoryRequirements requirements;
+                vkGetBufferMemoryRequirements(device.GetDevice(), buffer, &requirements);
+                Allocation allocation = Allocate(requirements, properties, ResourceKind::Linear);
+                vkBindBufferMemory(device.GetDevice(), buffer, allocation.memory, allocation.offset);
+                return allocation;
+            }
+
+            Allocation AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL, VkMemoryPropertyFlags preferred = 0) {
+                VkMemoryRequirements requirements;
+                vkGetImageMemoryRequirements(device.GetDevice(), image, &requirements);
+                Allocation allocation = Allocate(requirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear, preferred);
+                vkBindImageMemory(device.GetDevice(), image, allocation.memory, allocation.offset);
+                return allocation;
+            }
+
+            uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+                for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+                    if ((typeFilter & (1 << i)) &&
+                        (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                        return i;
+                    }
+                }
+                throw std::runtime_error("Failed to find suitable memory type.");
+            }
+
+            // A type with both properties and preferred if there is one, else one with just properties.
+            uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred) const {
+                if (preferred != 0 && HasMemoryType(typeFilter, properties | preferred)) {
+                    return FindMemoryType(typeFilter, properties | preferred);
+                }
+                return FindMemoryType(typeFilter, properties);
+            }
+
+            bool HasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+                for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+                    if ((typeFilter & (1 << i)) &&
+                        (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const {
+                return memoryProperties;
+            }
+
+            // One entry per memory heap.
+            std::vector<HeapStats> GetHeapStats() {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                std::vector<HeapStats> stats(memoryProperties.memoryHeapCount);
+                for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+                    stats[i].heapSize = memoryProperties.memoryHeaps[i].size;
+                }
+                for (size_t p = 0; p < pools.size(); p++) {
+                    auto& heap = stats[memoryProperties.memoryTypes[p / 2].heapIndex];
+                    for (auto& block : pools[p].blocks) {
+                        if (block.memory == VK_NULL_HANDLE) {
+                            continue;
+                        }
+                        heap.reservedBytes += block.size;
+                        heap.usedBytes += block.buddy ? block.buddy->GetUsed() : block.size;
+                        heap.blockCount++;
+                        heap.allocationCount += block.buddy ? block.allocationCount : 1;
+                    }
+                }
+                return stats;
+            }
+
+        private:
+            struct Block {
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                VkDeviceSize size = 0;
+                void* mapped = nullptr;
+                // Null for dedicated allocations.
+                std::unique_ptr<BuddyBlock> buddy;
+                uint32_t allocationCount = 0;
+            };
+
+            struct Pool {
+                // Destroyed blocks leave an empty slot behind so allocations can keep referring to blocks by index.
+                std::vector<Block> blocks;
+            };
+
+            Device& device;
+            VkPhysicalDeviceMemoryProperties memoryProperties{};
+            VkDeviceSize minRangeSize = MIN_RANGE_SIZE;
+            uint32_t maxAllocationCount = 0;
+            uint32_t liveAllocationCount = 0;
+
+            std::vector<Pool> pools;
+            std::mutex mtx;
+
+            // Small heaps (e.g. a 256 MiB device local, host visible BAR) get smaller blocks so one block cannot
+            // eat most of the heap.
+            VkDeviceSize GetBlockSize(uint32_t memoryType) const {
+                VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+                VkDeviceSize size = PREFERRED_BLOCK_SIZE;
+                while (size > minRangeSize && size > heapSize / 8) {
+                    size /= 2;
+                }
+                return size;
+            }
+
+            Block& CreateBlock(Pool& pool, uint32_t memoryType, VkDeviceSize size, bool subAllocated) {
+                if (maxAllocationCount != 0 && liveAllocationCount >= maxAllocationCount) {
+                    throw std::runtime_error("Device memory allocation count limit reached.");
+                }
+
+                VkMemoryAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                allocInfo.allocationSize = size;
+                allocInfo.memoryTypeIndex = memoryType;
+
+                Block block;
+                block.size = size;
+                if (vkAllocateMemory(device.GetDevice(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate device memory block.");
+                }
+                liveAllocationCount++;
+
+                if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                    vkMapMemory(device.GetDevice(), block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+                }
+                if (subAllocated) {
+                    block.buddy = std::make_unique<BuddyBlock>(size, minRangeSize);
+                }
+
+                for (auto& slot : pool.blocks) {
+                    if (slot.memory == VK_NULL_HANDLE) {
+                        slot = std::move(block);
+                        return slot;
+                    }
+                }
+                pool.blocks.push_back(std::move(block));
+                return pool.blocks.back();
+            }
+
+            void DestroyBlock(Block& block) {
+                if (block.mapped) {
+                    vkUnmapMemory(device.GetDevice(), block.memory);
+                }
+                vkFreeMemory(device.GetDevice(), block.memory, nullptr);
+                liveAllocationCount--;
+                block = Block{};
+            }
+
+            Allocation& Finish(Allocation& allocation, Block& block, uint32_t blockIndex) {
+                allocation.memory = block.memory;
+                allocation.block = blockIndex;
+                allocation.rangeSize = minRangeSize << allocation.order;
+                allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+                block.allocationCount++;
+                return allocation;
+            }
+
+            static size_t CountLiveBlocks(const Pool& pool) {
+                size_t count = 0;
+                for (auto& block : pool.blocks) {
+                    if (block.memory != VK_NULL_HANDLE && block.buddy) {
+                        count++;
+                    }
+                }
+                return count;
+            }
+    };
+}
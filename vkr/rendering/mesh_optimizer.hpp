@@ -0,0 +1,314 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace vkr {
+    struct VertexCacheStats {
+        // Vertices the simulated post-transform cache missed on, i.e. vertex shader invocations.
+        uint32_t vertexShaderInvocations = 0;
+        // Average cache miss ratio, invocations per triangle. 3 for a triangle soup, 0.5 is the best a large
+        // regular grid can reach.
+        float acmr = 0.0f;
+        // Average transformed vertex ratio, invocations per unique vertex. 1 is optimal.
+        float atvr = 0.0f;
+    };
+
+    // Simulates a FIFO post-transform cache, the model most hardware is closest to.
+    inline VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16) {
+        VertexCacheStats stats;
+        std::vector<uint32_t> timestamps(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+        for (uint32_t index : indices) {
+            if (time - timestamps[index] > cacheSize) {
+                timestamps[index] = time++;
+                stats.vertexShaderInvocations++;
+            }
+        }
+        if (!indices.empty()) {
+            stats.acmr = float(stats.vertexShaderInvocations) / float(indices.size() / 3);
+        }
+        if (vertexCount > 0) {
+            stats.atvr = float(stats.vertexShaderInvocations) / float(vertexCount);
+        }
+        return stats;
+    }
+
+    // Welds bit-identical vertices of a non-indexed triangle list. vertices is replaced with the unique vertices,
+    // the returned indices draw the same triangles.
+    template <class V>
+    std::vector<uint32_t> GenerateIndices(std::vector<V>& vertices) {
+        struct Hash {
+            size_t operator()(const V& v) const {
+                // FNV-1a over the raw bytes, vertices are plain float structs.
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&v);
+                size_t hash = 14695981039346656037ull;
+                for (size_t i = 0; i < sizeof(V); i++) {
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+                }
+                return hash;
+            }
+        };
+        struct Equal {
+            bool operator()(const V& a, const V& b) const {
+                return memcmp(&a, &b, sizeof(V)) == 0;
+            }
+        };
+
+        std::unordered_map<V, uint32_t, Hash, Equal> unique;
+        unique.reserve(vertices.size());
+        std::vector<V> uniqueVertices;
+        std::vector<uint32_t> indices;
+        indices.reserve(vertices.size());
+
+        for (auto& vertex : vertices) {
+            auto [it, inserted] = unique.emplace(vertex, static_cast<uint32_t>(uniqueVertices.size()));
+            if (inserted) {
+                uniqueVertices.push_back(vertex);
+            }
+            indices.push_back(it->second);
+        }
+
+        vertices = std::move(uniqueVertices);
+        return indices;
+    }
+
+    // Reorders triangles for post-transform cache reuse with Tom Forsyth's linear-speed vertex cache optimisation.
+    // Vertices score higher the more recently they were used and the fewer unemitted triangles they have left, and
+    // the triangle with the best total score among those touching the cache goes next.
+    inline void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+        constexpr int CACHE_SIZE = 32;
+        constexpr float CACHE_DECAY_POWER = 1.5f;
+        constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+        constexpr float VALENCE_BOOST_SCALE = 2.0f;
+        constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+
+        // Triangles using each vertex, packed with offsets. Emitted triangles are swapped out of the live range.
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (uint32_t index : indices) {
+            liveTriangles[index]++;
+        }
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + liveTriangles[v];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+            }
+        }
+
+        auto score = [&](uint32_t vertex, int cachePosition) {
+            if (liveTriangles[vertex] == 0) {
+                return -1.0f;
+            }
+            float result = 0.0f;
+            if (cachePosition >= 0) {
+                if (cachePosition < 3) {
+                    result = LAST_TRIANGLE_SCORE;
+                }
+                else {
+                    float scaled = 1.0f - float(cachePosition - 3) / float(CACHE_SIZE - 3);
+                    result = std::pow(scaled, CACHE_DECAY_POWER);
+                }
+            }
+            return result + VALENCE_BOOST_SCALE * std::pow(float(liveTriangles[vertex]), -VALENCE_BOOST_POWER);
+        };
+
+        std::vector<int> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            vertexScores[v] = score(static_cast<uint32_t>(v), -1);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache;
+        cache.reserve(CACHE_SIZE + 3);
+        std::vector<uint32_t> nextCache;
+        nextCache.reserve(CACHE_SIZE + 3);
+
+        size_t cursor = 0;
+        int64_t best = -1;
+        while (result.size() < indices.size()) {
+            if (best < 0) {
+                // Nothing in the cache has triangles left, restart from the next unemitted triangle.
+                while (emitted[cursor]) {
+                    cursor++;
+                }
+                best = static_cast<int64_t>(cursor);
+            }
+
+            const uint32_t* triangle = &indices[best * 3];
+            emitted[best] = true;
+            result.insert(result.end(), triangle, triangle + 3);
+
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = triangle[k];
+                uint32_t* begin = &adjacency[offsets[vertex]];
+                uint32_t* end = begin + liveTriangles[vertex];
+                *std::find(begin, end, static_cast<uint32_t>(best)) = *(end - 1);
+                liveTriangles[vertex]--;
+            }
+
+            // Move the triangle's vertices to the front of the cache, keep the rest in order.
+            nextCache.assign(triangle, triangle + 3);
+            for (uint32_t vertex : cache) {
+                if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                    nextCache.push_back(vertex);
+                }
+            }
+            for (size_t i = CACHE_SIZE; i < nextCache.size(); i++) {
+                cachePositions[nextCache[i]] = -1;
+                vertexScores[nextCache[i]] = score(nextCache[i], -1);
+            }
+            nextCache.resize(std::min<size_t>(nextCache.size(), CACHE_SIZE));
+            cache.swap(nextCache);
+
+            for (size_t i = 0; i < cache.size(); i++) {
+                cachePositions[cache[i]] = static_cast<int>(i);
+                vertexScores[cache[i]] = score(cache[i], static_cast<int>(i));
+            }
+
+            best = -1;
+            float bestScore = -1.0f;
+            for (uint32_t vertex : cache) {
+                for (uint32_t i = 0; i < liveTriangles[vertex]; i++) {
+                    uint32_t t = adjacency[offsets[vertex] + i];
+                    float s = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                    triangleScores[t] = s;
+                    if (s > bestScore) {
+                        bestScore = s;
+                        best = t;
+                    }
+                }
+            }
+        }
+
+        indices = std::move(result);
+    }
+
+    // Reorders clusters of triangles so that the ones facing outwards from the mesh centre are drawn first and
+    // occlude the rest, after Sander et al.'s fast triangle reordering. Clusters are split where the cache-optimised
+    // order already misses on every vertex, so vertex cache efficiency is kept. Run after OptimizeVertexCache.
+    template <class V>
+    void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<V>& vertices, uint32_t cacheSize = 16) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2) {
+            return;
+        }
+
+        std::vector<size_t> clusterStarts;
+        std::vector<uint32_t> timestamps(vertices.size(), 0);
+        uint32_t time = cacheSize + 1;
+        for (size_t t = 0; t < triangleCount; t++) {
+            int misses = 0;
+            for (int k = 0; k < 3; k++) {
+                uint32_t index = indices[t * 3 + k];
+                if (time - timestamps[index] > cacheSize) {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3) {
+                clusterStarts.push_back(t);
+            }
+        }
+        clusterStarts.push_back(triangleCount);
+
+        auto position = [&](uint32_t index, int axis) {
+            return float(vertices[index].position[axis]);
+        };
+
+        float meshCentroid[3] = {0, 0, 0};
+        for (uint32_t index : indices) {
+            for (int a = 0; a < 3; a++) {
+                meshCentroid[a] += position(index, a);
+            }
+        }
+        for (int a = 0; a < 3; a++) {
+            meshCentroid[a] /= float(indices.size());
+        }
+
+        struct Cluster {
+            size_t begin;
+            size_t end;
+            float key;
+        };
+        std::vector<Cluster> clusters;
+        for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+            float centroid[3] = {0, 0, 0};
+            float normal[3] = {0, 0, 0};
+            float area = 0.0f;
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+                uint32_t i0 = indices[t * 3], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+                float e1[3], e2[3];
+                for (int a = 0; a < 3; a++) {
+                    e1[a] = position(i1, a) - position(i0, a);
+                    e2[a] = position(i2, a) - position(i0, a);
+                }
+                float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+                float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                for (int a = 0; a < 3; a++) {
+                    centroid[a] += (position(i0, a) + position(i1, a) + position(i2, a)) / 3.0f * triangleArea;
+                    normal[a] += n[a];
+                }
+                area += triangleArea;
+            }
+
+            float key = 0.0f;
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (area > 0.0f && length > 0.0f) {
+                for (int a = 0; a < 3; a++) {
+                    key += (centroid[a] / area - meshCentroid[a]) * normal[a] / length;
+                }
+            }
+            clusters.push_back({clusterStarts[c], clusterStarts[c + 1], key});
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (auto& cluster : clusters) {
+            result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+        }
+        indices = std::move(result);
+    }
+
+    // Renumbers vertices in the order the index buffer first uses them, so vertex fetch walks memory forwards.
+    // Vertices no index refers to are dropped.
+    template <class V>
+    void OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<V>& vertices) {
+        constexpr uint32_t UNUSED = ~0u;
+        std::vector<uint32_t> remap(vertices.size(), UNUSED);
+        std::vector<V> ordered;
+        ordered.reserve(vertices.size());
+        for (uint32_t& index : indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = static_cast<uint32_t>(ordered.size());
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(ordered);
+    }
+}
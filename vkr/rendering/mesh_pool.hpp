@@ -1,60 +1,314 @@
 #pragma once
 
+#include "mesh_optimizer.hpp"
+#include "range_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
 namespace vkr {
+    // Where a mesh lives inside its arena. Offsets and counts are in elements. firstVertex goes to vkCmdDrawIndexed
+    // as the vertex offset, so indices stay local to the mesh and small meshes keep 16-bit indices.
+    struct MeshRange {
+        uint32_t page = 0;
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    };
+
+    // Packs the vertex and index data of every mesh of one vertex format into a few large device local buffers, so
+    // renderers bind them once instead of once per mesh. Space comes in pages of one vertex buffer and one index
+    // buffer per index type, and a new page is only made when no existing page has room.
+    //
+    // Only holds the BufferManager by reference. Pages are only made while the renderer is up, giving a range back
+    // is bookkeeping and stays safe after shutdown.
+    class MeshArena {
+        public:
+            static constexpr uint32_t PAGE_VERTEX_COUNT = 1u << 18;
+            static constexpr uint32_t PAGE_INDEX_COUNT = 1u << 20;
+
+            MeshArena(BufferManager& bm, VkDeviceSize vs) : bufferManager{bm}, vertexSize{vs} {
+
+            }
+
+            MeshRange Allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType) {
+                std::lock_guard<std::mutex> lock(mtx);
+                MeshRange range;
+                range.vertexCount = vertexCount;
+                range.indexCount = indexCount;
+                range.indexType = indexType;
+
+                for (uint32_t p = 0; p < pages.size(); p++) {
+                    if (TryAllocate(p, range)) {
+                        return range;
+                    }
+                }
+
+                Page page;
+                page.vertices = RangeAllocator(std::max(PAGE_VERTEX_COUNT, vertexCount));
+                VkDeviceSize size = vertexSize;
+                uint32_t count = page.vertices.GetCapacity();
+                page.vertexBuffer = bufferManager.CreateBuffer(size, count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                bufferManager.AddBufferToBufferPool(page.vertexBuffer);
+                pages.push_back(std::move(page));
+
+                if (!TryAllocate(static_cast<uint32_t>(pages.size() - 1), range)) {
+                    throw std::runtime_error("Failed to allocate mesh range.");
+                }
+                return range;
+            }
+
+            void Free(const MeshRange& range) {
+                std::lock_guard<std::mutex> lock(mtx);
+                Page& page = pages[range.page];
+                page.vertices.Free(range.firstVertex, range.vertexCount);
+                page.indices[IndexSlot(range.indexType)].Free(range.firstIndex, range.indexCount);
+            }
+
+            // Queues the range's vertex and index data on the uploader. onResident runs once for each of the two.
+            void Upload(const MeshRange& range, const void* vertices, const std::vector<uint32_t>& indices, std::function<void()> onResident) {
+                std::shared_ptr<Buffer> vertexBuffer = GetVertexBuffer(range.page);
+                std::shared_ptr<Buffer> indexBuffer = GetIndexBuffer(range.page, range.indexType);
+
+                bufferManager.Upload(vertices, vertexSize * range.vertexCount, vertexBuffer, vertexSize * range.firstVertex, onResident);
+                if (range.indexType == VK_INDEX_TYPE_UINT16) {
+                    std::vector<uint16_t> narrow(indices.begin(), indices.end());
+                    bufferManager.Upload(narrow.data(), sizeof(uint16_t) * narrow.size(), indexBuffer, sizeof(uint16_t) * range.firstIndex, onResident);
+                }
+                else {
+                    bufferManager.Upload(indices.data(), sizeof(uint32_t) * indices.size(), indexBuffer, sizeof(uint32_t) * range.firstIndex, onResident);
+                }
+            }
+
+            std::shared_ptr<Buffer> GetVertexBuffer(uint32_t page) {
+                std::lock_guard<std::mutex> lock(mtx);
+                return pages[page].vertexBuffer;
+            }
+
+            std::shared_ptr<Buffer> GetIndexBuffer(uint32_t page, VkIndexType indexType) {
+                std::lock_guard<std::mutex> lock(mtx);
+                return pages[page].indexBuffers[IndexSlot(indexType)];
+            }
+
+            size_t GetPageCount() {
+                std::lock_guard<std::mutex> lock(mtx);
+                return pages.size();
+            }
+
+            uint32_t GetUsedVertices() {
+                std::lock_guard<std::mutex> lock(mtx);
+                uint32_t used = 0;
+                for (auto& page : pages) {
+                    used += page.vertices.GetUsed();
+                }
+                return used;
+            }
+
+        private:
+            struct Page {
+                std::shared_ptr<Buffer> vertexBuffer;
+                RangeAllocator vertices;
+                // Indexed by IndexSlot, made the first time a mesh with that index type lands in the page.
+                std::shared_ptr<Buffer> indexBuffers[2];
+                RangeAllocator indices[2];
+            };
+
+            BufferManager& bufferManager;
+            VkDeviceSize vertexSize;
+
+            std::vector<Page> pages;
+            std::mutex mtx;
+
+            static int IndexSlot(VkIndexType indexType) {
+                return indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1;
+            }
+
+            bool TryAllocate(uint32_t p, MeshRange& range) {
+                Page& page = pages[p];
+                const int slot = IndexSlot(range.indexType);
+
+                if (!page.indexBuffers[slot]) {
+                    // Only start an index buffer in a page that can take the vertices too.
+                    if (page.vertices.GetCapacity() - page.vertices.GetUsed() < range.vertexCount) {
+                        return false;
+                    }
+                    page.indices[slot] = RangeAllocator(std::max(PAGE_INDEX_COUNT, range.indexCount));
+                    VkDeviceSize size = range.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+                    uint32_t count = page.indices[slot].GetCapacity();
+                    page.indexBuffers[slot] = bufferManager.CreateBuffer(size, count, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                    bufferManager.AddBufferToBufferPool(page.indexBuffers[slot]);
+                }
+
+                if (!page.vertices.Allocate(range.vertexCount, range.firstVertex)) {
+                    return false;
+                }
+                if (!page.indices[slot].Allocate(range.indexCount, range.firstIndex)) {
+                    page.vertices.Free(range.firstVertex, range.vertexCount);
+                    return false;
+                }
+                range.page = p;
+                return true;
+            }
+    };
+
+    // A range of its arena, given back when the last reference goes. Snapshots and in-flight frames hold meshes by
+    // shared_ptr, so a range is never reused while something may still draw from it.
     class Mesh {
         public:
-            Mesh(std::shared_ptr<BufferManager> bm, std::vector<Vertex2D>& v) : vertices2D{v} {
-                vertexBuffer = bm->CreateVertexBuffer(v);
+            Mesh(std::shared_ptr<MeshArena> a, std::vector<Vertex2D>& v) : arena{a}, vertices2D{v} {
+                indices = GenerateIndices(vertices2D);
+                Build(vertices2D);
             }
-            Mesh(std::shared_ptr<BufferManager> bm, std::vector<Vertex3D>& v) : vertices3D{v} {
-                vertexBuffer = bm->CreateVertexBuffer(v);
+            Mesh(std::shared_ptr<MeshArena> a, std::vector<Vertex3D>& v) : arena{a}, vertices3D{v} {
+                indices = GenerateIndices(vertices3D);
+                Build(vertices3D);
             }
-            Mesh(std::shared_ptr<BufferManager> bm, std::vector<Vertex2D>& v, std::vector<uint32_t>& i) : vertices2D{v}, indices{i} {
-                vertexBuffer = bm->CreateVertexBuffer(v);
+            Mesh(std::shared_ptr<MeshArena> a, std::vector<Vertex2D>& v, std::vector<uint32_t>& i) : arena{a}, vertices2D{v}, indices{i} {
+                Build(vertices2D);
             }
-            Mesh(std::shared_ptr<BufferManager> bm, std::vector<Vertex3D>& v, std::vector<uint32_t>& i) : vertices3D{v}, indices{i} {
-                vertexBuffer = bm->CreateVertexBuffer(v);
+            Mesh(std::shared_ptr<MeshArena> a, std::vector<Vertex3D>& v, std::vector<uint32_t>& i) : arena{a}, vertices3D{v}, indices{i} {
+                Build(vertices3D);
+            }
+
+            ~Mesh() {
+                arena->Free(range);
             }
 
+            Mesh(const Mesh&) = delete;
+            Mesh& operator=(const Mesh&) = delete;
+
+            const MeshRange& GetRange() const {
+                return range;
+            }
             std::shared_ptr<Buffer> GetVertexBuffer() {
-                return vertexBuffer;
+                return arena->GetVertexBuffer(range.page);
             }
             std::shared_ptr<Buffer> GetIndexBuffer() {
-                return indexBuffer;
+                return arena->GetIndexBuffer(range.page, range.indexType);
+            }
+            uint32_t GetIndexCount() const {
+                return range.indexCount;
+            }
+            VkIndexType GetIndexType() const {
+                return range.indexType;
+            }
+            // Centre in xyz and radius in w, in the mesh's own space.
+            const qbn::vec<float, 4>& GetBoundingSphere() const {
+                return boundingSphere;
+            }
+            // The arena's buffers are shared, so residency is tracked per mesh rather than per buffer.
+            bool IsResident() const {
+                return pendingUploads->load(std::memory_order_acquire) == 0;
             }
         private:
+            std::shared_ptr<MeshArena> arena;
+            MeshRange range;
+            qbn::vec<float, 4> boundingSphere{0, 0, 0, 0};
+
             std::vector<Vertex2D> vertices2D;
             std::vector<Vertex3D> vertices3D;
             std::vector<uint32_t> indices;
 
-            std::shared_ptr<Buffer> vertexBuffer;
-            std::shared_ptr<Buffer> indexBuffer;
+            // Shared with the upload callbacks, which may outlive the mesh.
+            std::shared_ptr<std::atomic<int>> pendingUploads = std::make_shared<std::atomic<int>>(2);
+
+            // Reorders the triangles for the post-transform cache, then for overdraw when there is a depth to sort
+            // by, then the vertices for fetch locality, and uploads the result into the arena.
+            template <class V>
+            void Build(std::vector<V>& vertices) {
+                if (indices.empty() || indices.size() % 3 != 0) {
+                    throw std::runtime_error("Index count must be a non-zero multiple of 3.");
+                }
+                for (uint32_t index : indices) {
+                    if (index >= vertices.size()) {
+                        throw std::runtime_error("Index out of range of the mesh's vertices.");
+                    }
+                }
+
+                OptimizeVertexCache(indices, vertices.size());
+                if constexpr (std::is_same_v<V, Vertex3D>) {
+                    OptimizeOverdraw(indices, vertices);
+                }
+                OptimizeVertexFetch(indices, vertices);
+                ComputeBoundingSphere(vertices);
+
+                range = arena->Allocate(static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(indices.size()), BufferManager::SelectIndexType(vertices.size()));
+                arena->Upload(range, vertices.data(), indices, [pending = pendingUploads]() {
+                    pending->fetch_sub(1, std::memory_order_release);
+                });
+            }
+
+            // Centred on the bounding box, loose but cheap and stable.
+            template <class V>
+            void ComputeBoundingSphere(const std::vector<V>& vertices) {
+                constexpr int AXES = std::is_same_v<V, Vertex3D> ? 3 : 2;
+                float low[3] = {0, 0, 0};
+                float high[3] = {0, 0, 0};
+                for (int a = 0; a < AXES; a++) {
+                    low[a] = high[a] = vertices[0].position[a];
+                }
+                for (auto& vertex : vertices) {
+                    for (int a = 0; a < AXES; a++) {
+                        low[a] = std::min(low[a], float(vertex.position[a]));
+                        high[a] = std::max(high[a], float(vertex.position[a]));
+                    }
+                }
+
+                float radiusSquared = 0.0f;
+                for (auto& vertex : vertices) {
+                    float distanceSquared = 0.0f;
+                    for (int a = 0; a < AXES; a++) {
+                        float d = vertex.position[a] - (low[a] + high[a]) * 0.5f;
+                        distanceSquared += d * d;
+                    }
+                    radiusSquared = std::max(radiusSquared, distanceSquared);
+                }
+                boundingSphere = {(low[0] + high[0]) * 0.5f, (low[1] + high[1]) * 0.5f, (low[2] + high[2]) * 0.5f, std::sqrt(radiusSquared)};
+            }
     };
 
     class MeshPool {
         public:
             MeshPool(std::shared_ptr<BufferManager> bm) : bufferManager{bm} {
-
+                arena2D = std::make_shared<MeshArena>(*bufferManager, sizeof(Vertex2D));
+                arena3D = std::make_shared<MeshArena>(*bufferManager, sizeof(Vertex3D));
             }
             std::shared_ptr<Mesh> CreateMesh(std::vector<Vertex2D>& v) {
-                return std::make_shared<Mesh>(bufferManager, v);
+                return std::make_shared<Mesh>(arena2D, v);
             }
             std::shared_ptr<Mesh> CreateMesh(std::vector<Vertex3D>& v) {
-                return std::make_shared<Mesh>(bufferManager, v);
+                return std::make_shared<Mesh>(arena3D, v);
             }
             std::shared_ptr<Mesh> CreateMesh(std::vector<Vertex2D>& v, std::vector<uint32_t>& i) {
-                return std::make_shared<Mesh>(bufferManager, v, i);
+                return std::make_shared<Mesh>(arena2D, v, i);
             }
             std::shared_ptr<Mesh> CreateMesh(std::vector<Vertex3D>& v, std::vector<uint32_t>& i) {
-                return std::make_shared<Mesh>(bufferManager, v, i);
+                return std::make_shared<Mesh>(arena3D, v, i);
             }
             std::shared_ptr<Mesh> AddMeshToMeshPool(std::shared_ptr<Mesh> mesh) {
                 mesh_pool.push_back(mesh);
                 return mesh;
             }
+            MeshArena& GetArena2D() {
+                return *arena2D;
+            }
+            MeshArena& GetArena3D() {
+                return *arena3D;
+            }
         private:
             std::shared_ptr<BufferManager> bufferManager;
+            std::shared_ptr<MeshArena> arena2D;
+            std::shared_ptr<MeshArena> arena3D;
 
             std::vector<std::shared_ptr<Mesh>> mesh_pool;
     };
-}
\ No newline at end of file
+}
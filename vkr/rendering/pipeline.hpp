@@ -1,39 +1,47 @@
 #pragma once
 
+#include "../../structs/structs.hpp"
+
 #include <fstream>
 #include <vector>
 #include <string>
 
 namespace vkr {
+    // Fixed function state of a graphics pipeline, see Pipeline::DefaultPipelineConfig.
+    struct PipelineConfigInfo {
+        VkPipelineViewportStateCreateInfo viewportInfo;
+        VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
+        VkPipelineRasterizationStateCreateInfo rasterizationInfo;
+        VkPipelineMultisampleStateCreateInfo multisampleInfo;
+        VkPipelineColorBlendAttachmentState colorBlendAttachment;
+        VkPipelineColorBlendStateCreateInfo colorBlendInfo;
+        VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+        std::vector<VkDynamicState> dynamicStateEnables;
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+        VkPipelineLayout pipelineLayout = nullptr;
+        VkRenderPass renderPass = nullptr;
+        uint32_t subpass = 0;
+    };
+
+    // One compiled graphics pipeline. The layout and shader modules belong to the PipelineLibrary that built it and
+    // are shared with other pipelines, get pipelines from the library rather than constructing them directly.
     class Pipeline {
         public:
-            Pipeline(Device& d, Swapchain& s, VkPrimitiveTopology t, const std::string& vertexShaderPath, const std::string& fragmentShaderPath, uint32_t typeIndex = 0) : device{d}, swapchain{s} {
-                CreatePipelineLayout();
-                auto configInfo = DefaultPipelineConfig(t);
-                CreatePipeline(typeIndex, configInfo, vertexShaderPath, fragmentShaderPath);
+            Pipeline(Device& d, VkPipelineLayout layout, VkRenderPass renderPass, PipelineConfigInfo& configInfo, VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule, uint32_t typeIndex) : device{d}, pipelineLayout{layout} {
+                configInfo.pipelineLayout = layout;
+                configInfo.renderPass = renderPass;
+                CreatePipeline(typeIndex, configInfo, vertexShaderModule, fragmentShaderModule);
             }
 
             ~Pipeline() {
                 vkDestroyPipeline(device.GetDevice(), pipeline, nullptr);
-                vkDestroyPipelineLayout(device.GetDevice(), pipelineLayout, nullptr);
             }
 
-            struct PipelineConfigInfo {
-                VkPipelineViewportStateCreateInfo viewportInfo;
-                VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
-                VkPipelineRasterizationStateCreateInfo rasterizationInfo;
-                VkPipelineMultisampleStateCreateInfo multisampleInfo;
-                VkPipelineColorBlendAttachmentState colorBlendAttachment;
-                VkPipelineColorBlendStateCreateInfo colorBlendInfo;
-                VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
-                std::vector<VkDynamicState> dynamicStateEnables;
-                VkPipelineDynamicStateCreateInfo dynamicStateInfo;
-                VkPipelineLayout pipelineLayout = nullptr;
-                VkRenderPass renderPass = nullptr;
-                uint32_t subpass = 0;
-            };
-
-            PipelineConfigInfo DefaultPipelineConfig(VkPrimitiveTopology topology) {
+            Pipeline(const Pipeline&) = delete;
+            Pipeline& operator=(const Pipeline&) = delete;
+
+
+            static PipelineConfigInfo DefaultPipelineConfig(VkPrimitiveTopology topology) {
                 PipelineConfigInfo configInfo{};
 
                 configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -106,12 +114,11 @@ namespace vkr {
                 return configInfo;
             }
 
-            void CreatePipeline(uint32_t typeIndex, PipelineConfigInfo& configInfo, const std::string& vertexShaderPath, const std::string& fragmentShaderPath) {
-                auto vertexShaderCode = ReadFile(vertexShaderPath);
-                auto fragmentShaderCode = ReadFile(fragmentShaderPath);
-
-                VkShaderModule vertexShaderModule = CreateShaderModule(vertexShaderCode);
-                VkShaderModule fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
+            void CreatePipeline(uint32_t typeIndex, PipelineConfigInfo& configInfo, VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule) {
+                // The config may have been copied since it was filled in, point its internal pointers at this copy.
+                configInfo.colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
+                configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+                configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 
                 VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
                 vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -138,6 +145,10 @@ namespace vkr {
                 else {
                     throw std::runtime_error("Invalid pipeline type index. (0 = 3D, 1 = 2D)");
                 }
+                auto instanceBindings = InstanceData::GetBindingDescriptions();
+                auto instanceAttributes = InstanceData::GetAttributeDescributions(static_cast<uint32_t>(attributeDescriptions.size()));
+                bindingDescriptions.insert(bindingDescriptions.end(), instanceBindings.begin(), instanceBindings.end());
+                attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
 
                 VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
                 vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -160,33 +171,40 @@ namespace vkr {
                 pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
                 pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
-                pipelineInfo.layout = pipelineLayout;
-                pipelineInfo.renderPass = swapchain.GetRenderPass();
+                pipelineInfo.layout = configInfo.pipelineLayout;
+                pipelineInfo.renderPass = configInfo.renderPass;
                 pipelineInfo.subpass = configInfo.subpass;
 
                 pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
                 pipelineInfo.basePipelineIndex = -1;
 
-                if (vkCreateGraphicsPipelines(device.GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+                if (vkCreateGraphicsPipelines(device.GetDevice(), device.GetPipelineCache().GetCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to create pipeline.");
                 }
-
-                vkDestroyShaderModule(device.GetDevice(), vertexShaderModule, nullptr);
-                vkDestroyShaderModule(device.GetDevice(), fragmentShaderModule, nullptr);
             }
 
-            void CreatePipelineLayout() {
-                VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-                pipelineLayoutInfo.setLayoutCount = 0;
-                pipelineLayoutInfo.pSetLayouts = nullptr;
-                pipelineLayoutInfo.pushConstantRangeCount = 0;
-                pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-                vkCreatePipelineLayout(device.GetDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout);
+            // Set 0 of the graphics pipeline layouts, the per-frame uniforms. PipelineLibrary and UniformRing each
+            // create one, identically defined layouts are compatible with any descriptor set allocated from either.
+            static VkDescriptorSetLayout CreateFrameSetLayout(Device& device) {
+                VkDescriptorSetLayoutBinding binding{};
+                binding.binding = 0;
+                binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                binding.descriptorCount = 1;
+                binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+                VkDescriptorSetLayoutCreateInfo layoutInfo{};
+                layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount = 1;
+                layoutInfo.pBindings = &binding;
+
+                VkDescriptorSetLayout layout;
+                if (vkCreateDescriptorSetLayout(device.GetDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create frame descriptor set layout.");
+                }
+                return layout;
             }
 
-            std::vector<char> ReadFile(const std::string& filename) {
+            static std::vector<char> ReadFile(const std::string& filename) {
                 std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
                 if (!file.is_open()) {
@@ -204,7 +222,7 @@ namespace vkr {
                 return buffer;
             }
 
-            VkShaderModule CreateShaderModule(const std::vector<char>& code) {
+            static VkShaderModule CreateShaderModule(Device& device, const std::vector<char>& code) {
                 VkShaderModuleCreateInfo createInfo{};
                 createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
                 createInfo.codeSize = code.size();
@@ -228,7 +246,6 @@ namespace vkr {
 
         private:
             Device& device;
-            Swapchain& swapchain;
 
             VkPipelineLayout pipelineLayout;
             VkPipeline pipeline;
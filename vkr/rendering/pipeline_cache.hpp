@@ -0,0 +1,136 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace vkr {
+    // The device's VkPipelineCache, kept on disk between runs so pipelines compiled once are not compiled again on
+    // the next launch. Loaded data is only handed to the driver when its header matches this device's vendor, device
+    // and pipelineCacheUUID, anything else (another GPU, a driver update, a truncated file) starts cold. Saves go to
+    // a temporary file that replaces the old one by rename, so a crash mid-write never leaves a corrupt cache.
+    class PipelineCache {
+        public:
+            PipelineCache(VkDevice d, VkPhysicalDevice physicalDevice) : device{d} {
+                vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+                Create({});
+            }
+
+            ~PipelineCache() {
+                vkDestroyPipelineCache(device, cache, nullptr);
+            }
+
+            PipelineCache(const PipelineCache&) = delete;
+            PipelineCache& operator=(const PipelineCache&) = delete;
+
+            // Replaces the cache with the contents of path, call before any pipeline is created. Saves go to path
+            // from then on. Returns whether the file was usable.
+            bool Load(const std::string& p) {
+                path = p;
+                std::ifstream file(path, std::ios::ate | std::ios::binary);
+                if (!file.is_open()) {
+                    return false;
+                }
+                size_t fileSize = static_cast<size_t>(file.tellg());
+                std::vector<uint8_t> data(fileSize);
+                file.seekg(0);
+                file.read(reinterpret_cast<char*>(data.data()), fileSize);
+                if (!file || !IsCompatible(data)) {
+                    return false;
+                }
+
+                vkDestroyPipelineCache(device, cache, nullptr);
+                Create(data);
+                loadedSize = savedSize = fileSize;
+                return true;
+            }
+
+            // Writes the cache to the loaded path if it grew since the last save. Cheap to call often.
+            bool Save() {
+                if (path.empty()) {
+                    return false;
+                }
+                size_t size = 0;
+                if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == savedSize) {
+                    return false;
+                }
+                std::vector<uint8_t> data(size);
+                if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+                    return false;
+                }
+                data.resize(size);
+
+                std::string temporaryPath = path + ".tmp";
+                {
+                    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+                    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+                    file.flush();
+                    if (!file) {
+                        std::error_code ignored;
+                        std::filesystem::remove(temporaryPath, ignored);
+                        return false;
+                    }
+                }
+                std::error_code error;
+                std::filesystem::rename(temporaryPath, path, error);
+                if (error) {
+                    std::filesystem::remove(temporaryPath, error);
+                    return false;
+                }
+                savedSize = size;
+                return true;
+            }
+
+            VkPipelineCache GetCache() const {
+                return cache;
+            }
+
+            // Bytes of compiled pipelines the cache started with, 0 on a cold start.
+            size_t GetLoadedSize() const {
+                return loadedSize;
+            }
+
+        private:
+            // VkPipelineCacheHeaderVersionOne, read field by field, the layout is fixed by the spec.
+            static constexpr size_t HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+            VkDevice device;
+            VkPhysicalDeviceProperties properties;
+            VkPipelineCache cache = VK_NULL_HANDLE;
+            std::string path;
+            size_t loadedSize = 0;
+            size_t savedSize = 0;
+
+            void Create(const std::vector<uint8_t>& data) {
+                VkPipelineCacheCreateInfo createInfo{};
+                createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+                createInfo.initialDataSize = data.size();
+                createInfo.pInitialData = data.empty() ? nullptr : data.data();
+                if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create pipeline cache.");
+                }
+            }
+
+            bool IsCompatible(const std::vector<uint8_t>& data) const {
+                if (data.size() < HEADER_SIZE) {
+                    return false;
+                }
+                uint32_t headerSize, headerVersion, vendorID, deviceID;
+                memcpy(&headerSize, data.data(), 4);
+                memcpy(&headerVersion, data.data() + 4, 4);
+                memcpy(&vendorID, data.data() + 8, 4);
+                memcpy(&deviceID, data.data() + 12, 4);
+
+                return headerSize >= HEADER_SIZE && headerSize <= data.size()
+                    && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                    && vendorID == properties.vendorID
+                    && deviceID == properties.deviceID
+                    && memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+            }
+    };
+}
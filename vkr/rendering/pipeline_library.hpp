@@ -0,0 +1,601 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vkr {
+    // What a renderer holds instead of a Pipeline or ComputePipeline, the pipeline may still be compiling. Only
+    // touched from the render thread, PipelineLibrary::ProcessCompleted fills it in between frames so a frame never
+    // sees it change.
+    template<typename P>
+    class BasicPipelineHandle {
+        public:
+            // Null until compiled, the draw is skipped until then.
+            P* GetPipeline() const {
+                return pipeline.get();
+            }
+
+            bool IsReady() const {
+                return pipeline != nullptr;
+            }
+
+            // Changes whenever GetPipeline would return a different pipeline and is never reused, unlike the
+            // pointer. 0 while there is nothing to draw with.
+            uint64_t GetGeneration() const {
+                return generation;
+            }
+
+            // Compilation threw, the handle never gets a pipeline.
+            bool HasFailed() const {
+                return failed;
+            }
+
+        private:
+            friend class PipelineLibrary;
+
+            std::shared_ptr<P> pipeline;
+            bool failed = false;
+            uint64_t generation = 0;
+
+            static inline std::atomic<uint64_t> nextGeneration{1};
+    };
+
+    using PipelineHandle = BasicPipelineHandle<Pipeline>;
+    using ComputePipelineHandle = BasicPipelineHandle<ComputePipeline>;
+
+    // A compute pipeline layout owned by the library, see PipelineLibrary::GetComputeLayout.
+    struct ComputeLayout {
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    };
+
+    // Builds graphics pipelines once per distinct description and hands out shared handles to them. The key covers
+    // the fixed function state of a PipelineConfigInfo, both shader paths, the vertex layout (typeIndex), the
+    // subpass and the RenderPassLayout, never a render pass handle. Pipelines are compiled against a render pass of
+    // the library's own built from the layout, so they work with any compatible pass and outlive the one a renderer
+    // asked with. Renderers asking for a pipeline that is still alive get the
+    // existing handle for the cost of a hash lookup, the last reference going away destroys it.
+    //
+    // Compilation runs on the library's own threads, so a renderer created mid-game never stalls the render thread.
+    // Finished pipelines reach their handles when ProcessCompleted is called at the next frame boundary. Shader
+    // modules are created once per path and pipeline layouts once per push constant size, both live as long as the
+    // library. Pipelines are compiled through the device's PipelineCache. Compute pipelines go the same way, keyed
+    // on the shader path and their ComputeLayout.
+    class PipelineLibrary {
+        public:
+            PipelineLibrary(Device& d, uint32_t compileThreadCount = 2) : device{d} {
+                frameSetLayout = Pipeline::CreateFrameSetLayout(device);
+                for (uint32_t t = 0; t < compileThreadCount; t++) {
+                    compileThreads.emplace_back(&PipelineLibrary::CompileThread, this);
+                }
+            }
+
+            // Handles given out must be released first.
+            ~PipelineLibrary() {
+                Stop();
+                completed.clear();
+                completedCompute.clear();
+                for (auto& [size, layout] : layouts) {
+                    vkDestroyPipelineLayout(device.GetDevice(), layout, nullptr);
+                }
+                for (auto& [key, layout] : computeLayouts) {
+                    vkDestroyPipelineLayout(device.GetDevice(), layout.pipelineLayout, nullptr);
+                    vkDestroyDescriptorSetLayout(device.GetDevice(), layout.setLayout, nullptr);
+                }
+                for (auto& [path, module] : shaderModules) {
+                    vkDestroyShaderModule(device.GetDevice(), module, nullptr);
+                }
+                for (auto& [key, renderPass] : renderPasses) {
+                    vkDestroyRenderPass(device.GetDevice(), renderPass, nullptr);
+                }
+                vkDestroyDescriptorSetLayout(device.GetDevice(), frameSetLayout, nullptr);
+            }
+
+            PipelineLibrary(const PipelineLibrary&) = delete;
+            PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+            // Returns straight away, a new handle has no pipeline until a later ProcessCompleted.
+            std::shared_ptr<PipelineHandle> GetPipeline(const PipelineConfigInfo& configInfo, const std::string& vertexShaderPath, const std::string& fragmentShaderPath, uint32_t typeIndex, const RenderPassLayout& renderPassLayout) {
+                std::string key = MakeKey(configInfo, vertexShaderPath, fragmentShaderPath, typeIndex, renderPassLayout);
+
+                std::lock_guard<std::mutex> lock{mutex};
+                auto it = handles.find(key);
+                if (it != handles.end()) {
+                    if (auto handle = it->second.lock()) {
+                        return handle;
+                    }
+                }
+
+                auto handle = std::make_shared<PipelineHandle>();
+                handles[key] = handle;
+                requests.push_back({handle, configInfo, vertexShaderPath, fragmentShaderPath, typeIndex, renderPassLayout});
+                pendingCompiles.fetch_add(1, std::memory_order_relaxed);
+                requestCv.notify_one();
+                return handle;
+            }
+
+            // One descriptor set of storageBufferCount storage buffers at bindings 0 onwards, plus pushConstantSize
+            // bytes of push constants, all for the compute stage. Created on first use, lives as long as the library.
+            ComputeLayout GetComputeLayout(uint32_t storageBufferCount, uint32_t pushConstantSize) {
+                const uint64_t key = (static_cast<uint64_t>(storageBufferCount) << 32) | pushConstantSize;
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    auto it = computeLayouts.find(key);
+                    if (it != computeLayouts.end()) {
+                        return it->second;
+                    }
+                }
+
+                std::vector<VkDescriptorSetLayoutBinding> bindings(storageBufferCount);
+                for (uint32_t b = 0; b < storageBufferCount; b++) {
+                    bindings[b].binding = b;
+                    bindings[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    bindings[b].descriptorCount = 1;
+                    bindings[b].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                }
+                VkDescriptorSetLayoutCreateInfo layoutInfo{};
+                layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                layoutInfo.bindingCount = storageBufferCount;
+                layoutInfo.pBindings = bindings.data();
+
+                ComputeLayout layout;
+                if (vkCreateDescriptorSetLayout(device.GetDevice(), &layoutInfo, nullptr, &layout.setLayout) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create compute descriptor set layout.");
+                }
+
+                VkPushConstantRange pushRange{};
+                pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                pushRange.offset = 0;
+                pushRange.size = pushConstantSize;
+
+                VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount = 1;
+                pipelineLayoutInfo.pSetLayouts = &layout.setLayout;
+                pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+                pipelineLayoutInfo.pPushConstantRanges = pushConstantSize > 0 ? &pushRange : nullptr;
+                if (vkCreatePipelineLayout(device.GetDevice(), &pipelineLayoutInfo, nullptr, &layout.pipelineLayout) != VK_SUCCESS) {
+                    vkDestroyDescriptorSetLayout(device.GetDevice(), layout.setLayout, nullptr);
+                    throw std::runtime_error("Failed to create compute pipeline layout.");
+                }
+
+                std::lock_guard<std::mutex> lock{mutex};
+                auto [it, inserted] = computeLayouts.emplace(key, layout);
+                if (!inserted) {
+                    vkDestroyPipelineLayout(device.GetDevice(), layout.pipelineLayout, nullptr);
+                    vkDestroyDescriptorSetLayout(device.GetDevice(), layout.setLayout, nullptr);
+                }
+                return it->second;
+            }
+
+            // Same as GetPipeline for a compute shader using GetComputeLayout(storageBufferCount, pushConstantSize).
+            std::shared_ptr<ComputePipelineHandle> GetComputePipeline(const std::string& shaderPath, uint32_t storageBufferCount, uint32_t pushConstantSize) {
+                std::string key;
+                Append(key, shaderPath);
+                Append(key, storageBufferCount);
+                Append(key, pushConstantSize);
+
+                std::lock_guard<std::mutex> lock{mutex};
+                auto it = computeHandles.find(key);
+                if (it != computeHandles.end()) {
+                    if (auto handle = it->second.lock()) {
+                        return handle;
+                    }
+                }
+
+                auto handle = std::make_shared<ComputePipelineHandle>();
+                computeHandles[key] = handle;
+                computeRequests.push_back({handle, shaderPath, storageBufferCount, pushConstantSize});
+                pendingCompiles.fetch_add(1, std::memory_order_relaxed);
+                requestCv.notify_one();
+                return handle;
+            }
+
+            // Hands compiled pipelines to their handles. Call on the render thread between frames.
+            void ProcessCompleted() {
+                std::vector<CompiledPipeline> done;
+                std::vector<CompiledComputePipeline> doneCompute;
+                {
+                    std::lock_guard<std::mutex> lock{completedMutex};
+                    done.swap(completed);
+                    doneCompute.swap(completedCompute);
+                }
+                for (auto& result : done) {
+                    Publish(*result.handle, std::move(result.pipeline));
+                }
+                for (auto& result : doneCompute) {
+                    Publish(*result.handle, std::move(result.pipeline));
+                }
+            }
+
+            // Saves the device's pipeline cache on a compile thread, so the disk write never lands on the caller.
+            // Dropped if the library stops first, the final save belongs on the shutdown path.
+            void RequestCacheSave() {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    saveRequested = true;
+                }
+                requestCv.notify_one();
+            }
+
+            // Finishes the compiles in progress and drops the queued ones.
+            void Stop() {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    if (finish) {
+                        return;
+                    }
+                    finish = true;
+                    pendingCompiles.fetch_sub(static_cast<uint32_t>(requests.size() + computeRequests.size()), std::memory_order_relaxed);
+                    requests.clear();
+                    computeRequests.clear();
+                }
+                requestCv.notify_all();
+                for (auto& thread : compileThreads) {
+                    if (thread.joinable()) {
+                        thread.join();
+                    }
+                }
+            }
+
+            // Requested and not compiled yet.
+            uint32_t GetPendingCompiles() const {
+                return pendingCompiles.load(std::memory_order_relaxed);
+            }
+
+            // Finished since the library was created, failures included.
+            uint64_t GetCompletedCompiles() const {
+                return completedCompiles.load(std::memory_order_relaxed);
+            }
+
+            uint64_t GetFailedCompiles() const {
+                return failedCompiles.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct CompileRequest {
+                std::shared_ptr<PipelineHandle> handle;
+                PipelineConfigInfo configInfo;
+                std::string vertexShaderPath;
+                std::string fragmentShaderPath;
+                uint32_t typeIndex;
+                RenderPassLayout renderPassLayout;
+            };
+
+            struct ComputeCompileRequest {
+                std::shared_ptr<ComputePipelineHandle> handle;
+                std::string shaderPath;
+                uint32_t storageBufferCount;
+                uint32_t pushConstantSize;
+            };
+
+            struct CompiledPipeline {
+                std::shared_ptr<PipelineHandle> handle;
+                // Null when compilation failed.
+                std::shared_ptr<Pipeline> pipeline;
+            };
+
+            struct CompiledComputePipeline {
+                std::shared_ptr<ComputePipelineHandle> handle;
+                std::shared_ptr<ComputePipeline> pipeline;
+            };
+
+            Device& device;
+            // Guards the requests, the save request, handles, layouts, shader modules and render passes.
+            std::mutex mutex;
+            std::condition_variable requestCv;
+            std::deque<CompileRequest> requests;
+            std::deque<ComputeCompileRequest> computeRequests;
+            bool saveRequested = false;
+            bool finish = false;
+
+            std::vector<CompiledPipeline> completed;
+            std::vector<CompiledComputePipeline> completedCompute;
+            std::mutex completedMutex;
+
+            std::atomic<uint32_t> pendingCompiles{0};
+            std::atomic<uint64_t> completedCompiles{0};
+            std::atomic<uint64_t> failedCompiles{0};
+            std::vector<std::thread> compileThreads;
+
+            VkDescriptorSetLayout frameSetLayout;
+            // Push constant size to layout, every layout has the frame set at set 0.
+            std::unordered_map<uint32_t, VkPipelineLayout> layouts;
+            std::unordered_map<std::string, VkShaderModule> shaderModules;
+            // Compatible render pass per layout (by AppendLayout key), only ever compiled against and never begun.
+            std::unordered_map<std::string, VkRenderPass> renderPasses;
+            std::unordered_map<std::string, std::weak_ptr<PipelineHandle>> handles;
+            // Storage buffer count in the high half, push constant size in the low.
+            std::unordered_map<uint64_t, ComputeLayout> computeLayouts;
+            std::unordered_map<std::string, std::weak_ptr<ComputePipelineHandle>> computeHandles;
+
+            void CompileThread() {
+                while (true) {
+                    CompileRequest request;
+                    ComputeCompileRequest computeRequest;
+                    bool compute = false;
+                    {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        requestCv.wait(lock, [this]{ return finish || saveRequested || !requests.empty() || !computeRequests.empty(); });
+                        if (finish && requests.empty() && computeRequests.empty()) {
+                            return;
+                        }
+                        if (saveRequested) {
+                            saveRequested = false;
+                            lock.unlock();
+                            device.GetPipelineCache().Save();
+                            continue;
+                        }
+                        // Compute first, there are few of them and a GpuCuller records nothing until it has both of its own.
+                        if (!computeRequests.empty()) {
+                            computeRequest = std::move(computeRequests.front());
+                            computeRequests.pop_front();
+                            compute = true;
+                        }
+                        else {
+                            request = std::move(requests.front());
+                            requests.pop_front();
+                        }
+                    }
+
+                    // Everything below runs unlocked, the pipeline cache is internally synchronised.
+                    bool compiled = compute ? Compile(computeRequest) : Compile(request);
+                    if (!compiled) {
+                        failedCompiles.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    completedCompiles.fetch_add(1, std::memory_order_relaxed);
+                    pendingCompiles.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            bool Compile(CompileRequest& request) {
+                CompiledPipeline result{request.handle, nullptr};
+                try {
+                    VkPipelineLayout layout = GetLayout(0);
+                    VkShaderModule vertexShaderModule = GetShaderModule(request.vertexShaderPath);
+                    VkShaderModule fragmentShaderModule = GetShaderModule(request.fragmentShaderPath);
+                    VkRenderPass renderPass = GetRenderPass(request.renderPassLayout);
+                    result.pipeline = std::make_shared<Pipeline>(device, layout, renderPass, request.configInfo, vertexShaderModule, fragmentShaderModule, request.typeIndex);
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Pipeline compile failed: " << e.what() << std::endl;
+                }
+                bool compiled = result.pipeline != nullptr;
+                std::lock_guard<std::mutex> lock{completedMutex};
+                completed.push_back(std::move(result));
+                return compiled;
+            }
+
+            bool Compile(ComputeCompileRequest& request) {
+                CompiledComputePipeline result{request.handle, nullptr};
+                try {
+                    ComputeLayout layout = GetComputeLayout(request.storageBufferCount, request.pushConstantSize);
+                    VkShaderModule shaderModule = GetShaderModule(request.shaderPath);
+                    result.pipeline = std::make_shared<ComputePipeline>(device, layout.pipelineLayout, shaderModule);
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Compute pipeline compile failed: " << e.what() << std::endl;
+                }
+                bool compiled = result.pipeline != nullptr;
+                std::lock_guard<std::mutex> lock{completedMutex};
+                completedCompute.push_back(std::move(result));
+                return compiled;
+            }
+
+            template<typename P>
+            static void Publish(BasicPipelineHandle<P>& handle, std::shared_ptr<P> pipeline) {
+                if (pipeline) {
+                    handle.pipeline = std::move(pipeline);
+                    handle.generation = BasicPipelineHandle<P>::nextGeneration.fetch_add(1, std::memory_order_relaxed);
+                }
+                else {
+                    handle.failed = true;
+                }
+            }
+
+            // The file is read and the module created without holding mutex, so GetPipeline on the render thread
+            // never waits on disk. Two threads may build the same module at once, the one that loses throws its away.
+            VkShaderModule GetShaderModule(const std::string& path) {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    auto it = shaderModules.find(path);
+                    if (it != shaderModules.end()) {
+                        return it->second;
+                    }
+                }
+
+                VkShaderModule module = Pipeline::CreateShaderModule(device, Pipeline::ReadFile(path));
+                std::lock_guard<std::mutex> lock{mutex};
+                auto [it, inserted] = shaderModules.emplace(path, module);
+                if (!inserted) {
+                    vkDestroyShaderModule(device.GetDevice(), module, nullptr);
+                }
+                return it->second;
+            }
+
+            // Same as GetShaderModule, created unlocked and the duplicate discarded.
+            VkPipelineLayout GetLayout(uint32_t pushConstantSize) {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    auto it = layouts.find(pushConstantSize);
+                    if (it != layouts.end()) {
+                        return it->second;
+                    }
+                }
+
+                VkPushConstantRange pushRange{};
+                pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+                pushRange.offset = 0;
+                pushRange.size = pushConstantSize;
+
+                VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount = 1;
+                pipelineLayoutInfo.pSetLayouts = &frameSetLayout;
+                pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+                pipelineLayoutInfo.pPushConstantRanges = pushConstantSize > 0 ? &pushRange : nullptr;
+
+                VkPipelineLayout layout;
+                if (vkCreatePipelineLayout(device.GetDevice(), &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create pipeline layout.");
+                }
+                std::lock_guard<std::mutex> lock{mutex};
+                auto [it, inserted] = layouts.emplace(pushConstantSize, layout);
+                if (!inserted) {
+                    vkDestroyPipelineLayout(device.GetDevice(), layout, nullptr);
+                }
+                return it->second;
+            }
+
+            // Same as GetShaderModule. Load and store ops and layouts are irrelevant to compatibility, so any will do.
+            VkRenderPass GetRenderPass(const RenderPassLayout& renderPassLayout) {
+                std::string key;
+                AppendLayout(key, renderPassLayout);
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    auto it = renderPasses.find(key);
+                    if (it != renderPasses.end()) {
+                        return it->second;
+                    }
+                }
+
+                std::vector<VkAttachmentDescription> attachments;
+                std::vector<VkAttachmentReference> colourReferences;
+                for (auto& colour : renderPassLayout.colourAttachments) {
+                    VkAttachmentDescription attachment{};
+                    attachment.format = colour.format;
+                    attachment.samples = colour.samples;
+                    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                    colourReferences.push_back({static_cast<uint32_t>(attachments.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+                    attachments.push_back(attachment);
+                }
+
+                VkSubpassDescription subpass{};
+                subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount = static_cast<uint32_t>(colourReferences.size());
+                subpass.pColorAttachments = colourReferences.data();
+
+                VkAttachmentReference depthReference{};
+                if (renderPassLayout.depthAttachment.format != VK_FORMAT_UNDEFINED) {
+                    VkAttachmentDescription attachment{};
+                    attachment.format = renderPassLayout.depthAttachment.format;
+                    attachment.samples = renderPassLayout.depthAttachment.samples;
+                    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                    depthReference = {static_cast<uint32_t>(attachments.size()), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+                    attachments.push_back(attachment);
+                    subpass.pDepthStencilAttachment = &depthReference;
+                }
+
+                VkRenderPassCreateInfo renderPassInfo{};
+                renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+                renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+                renderPassInfo.pAttachments = attachments.data();
+                renderPassInfo.subpassCount = 1;
+                renderPassInfo.pSubpasses = &subpass;
+
+                VkRenderPass renderPass;
+                if (vkCreateRenderPass(device.GetDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create compatible render pass.");
+                }
+                std::lock_guard<std::mutex> lock{mutex};
+                auto [it, inserted] = renderPasses.emplace(key, renderPass);
+                if (!inserted) {
+                    vkDestroyRenderPass(device.GetDevice(), renderPass, nullptr);
+                }
+                return it->second;
+            }
+
+            template<typename T>
+            static void Append(std::string& key, const T& value) {
+                key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+            }
+
+            static void Append(std::string& key, const std::string& value) {
+                Append(key, value.size());
+                key.append(value);
+            }
+
+            static void AppendLayout(std::string& key, const RenderPassLayout& renderPassLayout) {
+                Append(key, renderPassLayout.colourAttachments.size());
+                for (auto& colour : renderPassLayout.colourAttachments) {
+                    Append(key, colour.format);
+                    Append(key, colour.samples);
+                }
+                Append(key, renderPassLayout.depthAttachment.format);
+                Append(key, renderPassLayout.depthAttachment.samples);
+            }
+
+            // Only the state that reaches the driver, pointers and sTypes are left out. Render passes go in by
+            // what makes them compatible, see RenderPassLayout.
+            static std::string MakeKey(const PipelineConfigInfo& c, const std::string& vertexShaderPath, const std::string& fragmentShaderPath, uint32_t typeIndex, const RenderPassLayout& renderPassLayout) {
+                std::string key;
+                key.reserve(256);
+
+                Append(key, c.inputAssemblyInfo.topology);
+                Append(key, c.inputAssemblyInfo.primitiveRestartEnable);
+
+                Append(key, c.rasterizationInfo.depthClampEnable);
+                Append(key, c.rasterizationInfo.rasterizerDiscardEnable);
+                Append(key, c.rasterizationInfo.polygonMode);
+                Append(key, c.rasterizationInfo.cullMode);
+                Append(key, c.rasterizationInfo.frontFace);
+                Append(key, c.rasterizationInfo.depthBiasEnable);
+                Append(key, c.rasterizationInfo.depthBiasConstantFactor);
+                Append(key, c.rasterizationInfo.depthBiasClamp);
+                Append(key, c.rasterizationInfo.depthBiasSlopeFactor);
+                Append(key, c.rasterizationInfo.lineWidth);
+
+                Append(key, c.multisampleInfo.rasterizationSamples);
+                Append(key, c.multisampleInfo.sampleShadingEnable);
+                Append(key, c.multisampleInfo.minSampleShading);
+                Append(key, c.multisampleInfo.alphaToCoverageEnable);
+                Append(key, c.multisampleInfo.alphaToOneEnable);
+
+                Append(key, c.colorBlendAttachment);
+                Append(key, c.colorBlendInfo.logicOpEnable);
+                Append(key, c.colorBlendInfo.logicOp);
+                Append(key, c.colorBlendInfo.blendConstants);
+
+                Append(key, c.depthStencilInfo.depthTestEnable);
+                Append(key, c.depthStencilInfo.depthWriteEnable);
+                Append(key, c.depthStencilInfo.depthCompareOp);
+                Append(key, c.depthStencilInfo.depthBoundsTestEnable);
+                Append(key, c.depthStencilInfo.stencilTestEnable);
+                Append(key, c.depthStencilInfo.front);
+                Append(key, c.depthStencilInfo.back);
+                Append(key, c.depthStencilInfo.minDepthBounds);
+                Append(key, c.depthStencilInfo.maxDepthBounds);
+
+                Append(key, c.dynamicStateEnables.size());
+                for (auto state : c.dynamicStateEnables) {
+                    Append(key, state);
+                }
+
+                Append(key, vertexShaderPath);
+                Append(key, fragmentShaderPath);
+                Append(key, typeIndex);
+                AppendLayout(key, renderPassLayout);
+                Append(key, c.subpass);
+                return key;
+            }
+    };
+}
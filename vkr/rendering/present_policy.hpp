@@ -0,0 +1,34 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+namespace vkr {
+    // How frames are queued and presented, trading latency against throughput.
+    //
+    // FIFO is vsync and always available. MAILBOX renders unthrottled but only ever shows the newest frame, no
+    // tearing. IMMEDIATE presents straight away and may tear. FIFO_RELAXED is vsync, but a late frame tears instead of
+    // waiting a whole refresh. A mode the surface does not support falls back to FIFO.
+    //
+    // More frames in flight keep the GPU fed when CPU frame times vary, but each one is a frame of input lag once
+    // the GPU is the bottleneck. With late pacing the CPU blocks on the frame slot's fence before sampling input
+    // instead of after, so what gets drawn is as fresh as it can be. The cost is less CPU and GPU overlap.
+    struct PresentPolicy {
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        // Fixed once the renderer is built, every per frame ring is sized from it.
+        uint32_t framesInFlight = 2;
+        bool latePacing = false;
+        // Frames between averaged timing reports on stdout, 0 for none.
+        uint32_t timingReportInterval = 0;
+    };
+
+    inline const char* PresentModeName(VkPresentModeKHR presentMode) {
+        switch (presentMode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+            case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+            case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+            default: return "unknown";
+        }
+    }
+}
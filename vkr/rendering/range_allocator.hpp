@@ -0,0 +1,89 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+namespace vkr {
+    // Hands out ranges of a fixed size space, in elements rather than bytes. Free ranges are kept sorted by
+    // offset and merged with their neighbours when given back, allocation takes the smallest range that fits so
+    // large holes survive for large meshes. Not thread safe, the owner locks.
+    class RangeAllocator {
+        public:
+            RangeAllocator(uint32_t c = 0) : capacity{c} {
+                if (capacity > 0) {
+                    freeRanges[0] = capacity;
+                }
+            }
+
+            bool Allocate(uint32_t count, uint32_t& offset) {
+                if (count == 0) {
+                    offset = 0;
+                    return true;
+                }
+
+                auto best = freeRanges.end();
+                for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+                    if (it->second >= count && (best == freeRanges.end() || it->second < best->second)) {
+                        best = it;
+                        if (it->second == count) {
+                            break;
+                        }
+                    }
+                }
+                if (best == freeRanges.end()) {
+                    return false;
+                }
+
+                offset = best->first;
+                uint32_t remaining = best->second - count;
+                freeRanges.erase(best);
+                if (remaining > 0) {
+                    freeRanges[offset + count] = remaining;
+                }
+                used += count;
+                return true;
+            }
+
+            void Free(uint32_t offset, uint32_t count) {
+                if (count == 0) {
+                    return;
+                }
+                used -= count;
+
+                auto next = freeRanges.lower_bound(offset);
+                if (next != freeRanges.begin()) {
+                    auto previous = std::prev(next);
+                    if (previous->first + previous->second == offset) {
+                        offset = previous->first;
+                        count += previous->second;
+                        freeRanges.erase(previous);
+                    }
+                }
+                if (next != freeRanges.end() && offset + count == next->first) {
+                    count += next->second;
+                    freeRanges.erase(next);
+                }
+                freeRanges[offset] = count;
+            }
+
+            uint32_t GetCapacity() const {
+                return capacity;
+            }
+
+            uint32_t GetUsed() const {
+                return used;
+            }
+
+            size_t GetFreeRangeCount() const {
+                return freeRanges.size();
+            }
+
+        private:
+            uint32_t capacity;
+            uint32_t used = 0;
+            // Offset to length.
+            std::map<uint32_t, uint32_t> freeRanges;
+    };
+}
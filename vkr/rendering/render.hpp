@@ -1,23 +1,76 @@
 #pragma once
 
+#include "frame_resources.hpp"
+#include "frame_stats.hpp"
+
+// std
+#include <array>
+#include <chrono>
+#include <vector>
+
 namespace vkr {
+    // Records and submits frames. Up to MAX_FRAMES_IN_FLIGHT frames are queued on the GPU at once, the only wait
+    // is on the fence of the frame slot about to be reused. BeginFrame waits on it unless the caller already has
+    // through WaitForFrame, which late pacing does before sampling input.
     class Render {
         public:
-            Render(Swapchain& s, CommandPool& c) : swapchain{s}, commandPool{c} {
+            Render(Swapchain& s, CommandPool& c) : swapchain{s}, commandPool{c}, frames(s.MAX_FRAMES_IN_FLIGHT) {
 
             }
             ~Render() {
                 swapchain.DestroySyncObjects();
+                for (auto& frame : frames) {
+                    frame.Release();
+                }
+            }
+
+            // Blocks until the GPU is done with the frame slot about to be recorded and releases what it held.
+            // Does nothing if already called for this frame.
+            void WaitForFrame() {
+                if (isFrameWaited) {
+                    return;
+                }
+                auto frameStart = std::chrono::steady_clock::now();
+                uint32_t frame = static_cast<uint32_t>(swapchain.GetCurrentFrameIndex());
+                swapchain.WaitForFrame();
+                auto waitEnd = std::chrono::steady_clock::now();
+
+                // The GPU is done with everything this slot recorded last time round.
+                frames[frame].Release();
+                FrameStats frameStats;
+                frameStats.frameMilliseconds = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+                frameStats.fenceWaitMilliseconds = std::chrono::duration<double, std::milli>(waitEnd - frameStart).count();
+                frameStats.cpuMilliseconds = std::max(0.0, frameStats.frameMilliseconds - lastFenceWaitMilliseconds);
+                frameStats.gpuMilliseconds = gpuTimer.Collect(frame);
+                frameStats.ComputeOverlap();
+                stats = frameStats;
+                lastFrameStart = frameStart;
+                lastFenceWaitMilliseconds = frameStats.fenceWaitMilliseconds;
+                isFrameWaited = true;
+            }
+
+            // Marks when the input this frame is built from was read, for FrameStats::inputToSubmitMilliseconds.
+            void MarkInputSampled() {
+                inputSampled = std::chrono::steady_clock::now();
             }
 
             VkCommandBuffer BeginFrame() {
                 if (isFrameStarted == true) {
                     throw std::runtime_error("Cannot begin frame while already in progress.");
                 }
+                // A minimised window has nothing to present to, skip the frame rather than build a zero sized swapchain.
+                if (swapchain.GetWindow().IsMinimised()) {
+                    return nullptr;
+                }
+
+                uint32_t frame = static_cast<uint32_t>(swapchain.GetCurrentFrameIndex());
+                WaitForFrame();
 
                 auto result = swapchain.AcquireNextImage(&swapchain.GetCurrentImageIndex());
                 if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-                    swapchain.RecreateSwapchain();
+                    // Nothing was submitted this slot, the last frame that may use the old swapchain is the previous one.
+                    uint32_t previous = (frame + swapchain.MAX_FRAMES_IN_FLIGHT - 1) % swapchain.MAX_FRAMES_IN_FLIGHT;
+                    frames[previous].DeferDestroy(swapchain.RecreateSwapchain());
                     return nullptr;
                 }
 
@@ -36,11 +89,14 @@ namespace vkr {
                 if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to begin frame.");
                 }
+                gpuTimer.Begin(commandBuffer, frame);
 
                 return commandBuffer;
             }
 
-            void BeginSwapchainRenderpass(VkCommandBuffer commandBuffer) {
+            // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only execute secondaries, which set their
+            // own viewport and scissor.
+            void BeginSwapchainRenderpass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE) {
                 if (isFrameStarted != true) {
                     throw std::runtime_error("Cannot begin swapchain render pass if frame is not in progress.");
                 }
@@ -58,11 +114,14 @@ namespace vkr {
 
                 std::array<VkClearValue, 2> clearValues{};
                 clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
-                clearValues[1].depthStencil = {1.0f, 0}; // Might need to remove this
+                clearValues[1].depthStencil = {1.0f, 0};
                 renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
                 renderPassInfo.pClearValues = clearValues.data();
 
-                vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+                if (contents != VK_SUBPASS_CONTENTS_INLINE) {
+                    return;
+                }
 
                 VkViewport viewport{};
                 viewport.x = 0.0f;
@@ -91,26 +150,51 @@ namespace vkr {
                     throw std::runtime_error("Cannot end frame while frame is not in progress.");
                 }
                 auto commandBuffer = commandPool.GetCurrentCommandBuffer();
+                gpuTimer.End(commandBuffer, static_cast<uint32_t>(swapchain.GetCurrentFrameIndex()));
                 if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to record command buffer.");
                 }
 
                 auto result = swapchain.SubmitCommandBuffers(&commandBuffer, &swapchain.GetCurrentImageIndex());
-                if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || swapchain.GetWindow().WasWindowResized()) {
+                stats.inputToSubmitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inputSampled).count();
+                if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || swapchain.GetWindow().WasWindowResized() || swapchain.IsPresentModeChanged()) {
                     swapchain.GetWindow().ResetWindowResizedFlag();
-                    swapchain.RecreateSwapchain();
+                    if (!swapchain.GetWindow().IsMinimised()) {
+                        // Released once this frame's fence has signalled, every earlier frame has been waited on by then.
+                        GetCurrentFrameResources().DeferDestroy(swapchain.RecreateSwapchain());
+                    }
                 }
                 else if (result != VK_SUCCESS) {
                     throw std::runtime_error("Failed to present swap chain image.");
                 }
 
                 isFrameStarted = false;
+                isFrameWaited = false;
                 swapchain.GetCurrentFrameIndex() = (swapchain.GetCurrentFrameIndex() + 1) % swapchain.MAX_FRAMES_IN_FLIGHT;
             }
+            // Resources owned by the frame currently being recorded.
+            FrameResources& GetCurrentFrameResources() {
+                return frames[swapchain.GetCurrentFrameIndex()];
+            }
+
+            // Timings measured at the start of the most recent frame.
+            const FrameStats& GetFrameStats() const {
+                return stats;
+            }
+
         private:
             Swapchain& swapchain;
             CommandPool& commandPool;
 
+            std::vector<FrameResources> frames;
+            GpuTimer gpuTimer{swapchain.GetDevice(), static_cast<uint32_t>(swapchain.MAX_FRAMES_IN_FLIGHT)};
+
+            FrameStats stats;
+            std::chrono::steady_clock::time_point lastFrameStart = std::chrono::steady_clock::now();
+            double lastFenceWaitMilliseconds = 0.0;
+            std::chrono::steady_clock::time_point inputSampled = lastFrameStart;
+
             bool isFrameStarted{false};
+            bool isFrameWaited{false};
     };
 }
\ No newline at end of file
@@ -0,0 +1,633 @@
+#pragma once
+
+#include "frame_resources.hpp"
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vkr {
+    // How a pass touches a resource. Each maps to the pipeline stages, access mask and image layout the graph
+    // synchronises on.
+    enum class ResourceUsage {
+        ColourAttachment,
+        DepthAttachment,
+        DepthRead,
+        SampledFragment,
+        SampledCompute,
+        StorageReadCompute,
+        StorageWriteCompute,
+        TransferSource,
+        TransferDestination,
+        VertexInput,
+        IndirectRead,
+        UniformRead,
+        Present
+    };
+
+    // Passes declare the images and buffers they read and write, and record themselves. The graph works out
+    // everything in between.
+    //
+    // Compile runs once per topology change, when passes or transient descriptions change. It culls passes whose
+    // results nothing uses and gives each transient image its lifetime over the remaining passes. Transients whose
+    // lifetimes do not overlap share memory. Every barrier and layout transition is worked out up front, so Execute
+    // only patches in this frame's imported handles and issues one vkCmdPipelineBarrier before each pass that needs
+    // one. It allocates nothing.
+    //
+    // Render passes recorded inside a graph pass must keep the attachment in the declared layout, initialLayout and
+    // finalLayout both, or the graph's idea of the layout goes stale. A pass declares each resource once.
+    class RenderGraph {
+        public:
+            using ResourceHandle = uint32_t;
+
+            struct ImageDesc {
+                VkFormat format;
+                VkExtent2D extent;
+                VkImageUsageFlags usage;
+                VkImageAspectFlags aspect;
+            };
+
+            class PassBuilder {
+                public:
+                    PassBuilder(RenderGraph& g, uint32_t p) : graph{g}, pass{p} {}
+
+                    PassBuilder& Read(ResourceHandle resource, ResourceUsage usage) {
+                        graph.passes[pass].accesses.push_back({resource, usage, false});
+                        graph.compiled = false;
+                        return *this;
+                    }
+
+                    PassBuilder& Write(ResourceHandle resource, ResourceUsage usage) {
+                        graph.passes[pass].accesses.push_back({resource, usage, true});
+                        graph.compiled = false;
+                        return *this;
+                    }
+
+                    // Never culled, for passes whose effects the graph cannot see.
+                    PassBuilder& SideEffects() {
+                        graph.passes[pass].sideEffects = true;
+                        graph.compiled = false;
+                        return *this;
+                    }
+
+                private:
+                    RenderGraph& graph;
+                    uint32_t pass;
+            };
+
+            RenderGraph(Device& d) : device{d} {
+                vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &memoryProperties);
+            }
+
+            ~RenderGraph() {
+                DestroyTransients(device.GetDevice(), transients);
+            }
+
+            RenderGraph(const RenderGraph&) = delete;
+            RenderGraph& operator=(const RenderGraph&) = delete;
+
+            // An image owned outside the graph, set each frame with SetImage. It starts every frame in initialLayout
+            // after initialStage, and ends the frame in finalUsage's layout.
+            ResourceHandle ImportImage(const std::string& name, VkImageAspectFlags aspect, VkPipelineStageFlags initialStage, VkImageLayout initialLayout, ResourceUsage finalUsage) {
+                Resource resource;
+                resource.name = name;
+                resource.isImage = true;
+                resource.imported = true;
+                resource.desc.aspect = aspect;
+                resource.initialState = {initialStage, 0, initialLayout, false};
+                resource.finalState = GetUsageState(finalUsage);
+                resource.hasFinal = true;
+                return AddResource(resource);
+            }
+
+            // A buffer owned outside the graph, set each frame with SetBuffer.
+            ResourceHandle ImportBuffer(const std::string& name) {
+                Resource resource;
+                resource.name = name;
+                resource.imported = true;
+                resource.initialState = {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false};
+                return AddResource(resource);
+            }
+
+            // An image that only lives between the passes using it. The graph creates it, possibly in memory shared
+            // with other transients, and its contents never survive from one frame to the next.
+            ResourceHandle CreateImage(const std::string& name, const ImageDesc& desc) {
+                Resource resource;
+                resource.name = name;
+                resource.isImage = true;
+                resource.desc = desc;
+                return AddResource(resource);
+            }
+
+            // Passes run in the order they are added.
+            PassBuilder AddPass(const std::string& name, std::function<void(VkCommandBuffer)> execute) {
+                passes.push_back({name, {}, std::move(execute), false});
+                compiled = false;
+                return PassBuilder{*this, static_cast<uint32_t>(passes.size() - 1)};
+            }
+
+            // Forgets every pass and resource, to build a different topology.
+            void Clear() {
+                passes.clear();
+                resources.clear();
+                compiled = false;
+            }
+
+            void SetImage(ResourceHandle resource, VkImage image, VkImageView view) {
+                resources[resource].image = image;
+                resources[resource].view = view;
+            }
+
+            void SetBuffer(ResourceHandle resource, VkBuffer buffer) {
+                resources[resource].buffer = buffer;
+            }
+
+            VkImage GetImage(ResourceHandle resource) const {
+                return resources[resource].image;
+            }
+
+            VkImageView GetImageView(ResourceHandle resource) const {
+                return resources[resource].view;
+            }
+
+            VkBuffer GetBuffer(ResourceHandle resource) const {
+                return resources[resource].buffer;
+            }
+
+            bool IsCompiled() const {
+                return compiled;
+            }
+
+            // Passes left after culling, in execution order.
+            size_t GetLivePassCount() const {
+                return schedule.size();
+            }
+
+            // Bytes of device memory the transients occupy, and what they would without aliasing.
+            VkDeviceSize GetTransientMemorySize() const {
+                return transientMemorySize;
+            }
+
+            VkDeviceSize GetUnaliasedMemorySize() const {
+                return unaliasedMemorySize;
+            }
+
+            // Culls, places the transients and precomputes the barriers. The previous transients are destroyed once
+            // retire's frame has finished, or straight away without one, in which case nothing may still use them.
+            void Compile(FrameResources* retire = nullptr) {
+                if (retire) {
+                    VkDevice d = device.GetDevice();
+                    auto old = std::make_shared<Transients>(std::move(transients));
+                    retire->DeferDestroy([d, old]() { DestroyTransients(d, *old); });
+                }
+                else {
+                    DestroyTransients(device.GetDevice(), transients);
+                }
+                transients = {};
+                schedule.clear();
+                finalBarriers = {};
+
+                std::vector<bool> live = CullPasses();
+                for (uint32_t p = 0; p < passes.size(); p++) {
+                    if (live[p]) {
+                        schedule.push_back({p, {}});
+                    }
+                }
+                ComputeLifetimes();
+                AllocateTransients();
+                BuildBarriers();
+                compiled = true;
+            }
+
+            // Records every live pass with its barriers into commandBuffer.
+            void Execute(VkCommandBuffer commandBuffer) {
+                if (!compiled) {
+                    throw std::runtime_error("Render graph executed before being compiled.");
+                }
+                for (auto& scheduled : schedule) {
+                    Issue(commandBuffer, scheduled.barriers);
+                    passes[scheduled.pass].execute(commandBuffer);
+                }
+                Issue(commandBuffer, finalBarriers);
+            }
+
+        private:
+            struct UsageState {
+                VkPipelineStageFlags stage;
+                VkAccessFlags access;
+                VkImageLayout layout;
+                bool write;
+            };
+
+            struct Resource {
+                std::string name;
+                bool isImage = false;
+                bool imported = false;
+                ImageDesc desc{};
+                UsageState initialState{};
+                UsageState finalState{};
+                bool hasFinal = false;
+
+                VkImage image = VK_NULL_HANDLE;
+                VkImageView view = VK_NULL_HANDLE;
+                VkBuffer buffer = VK_NULL_HANDLE;
+
+                // Positions in the schedule of the first and last live pass using it, -1 if none does.
+                int firstUse = -1;
+                int lastUse = -1;
+                // Stages and writes of its last use, which the first use of anything aliasing it waits on.
+                VkPipelineStageFlags lastStage = 0;
+                VkAccessFlags lastWrites = 0;
+                // Transients placed in overlapping memory, itself included.
+                std::vector<ResourceHandle> aliases;
+            };
+
+            struct Access {
+                ResourceHandle resource;
+                ResourceUsage usage;
+                bool write;
+            };
+
+            struct Pass {
+                std::string name;
+                std::vector<Access> accesses;
+                std::function<void(VkCommandBuffer)> execute;
+                bool sideEffects;
+            };
+
+            // One vkCmdPipelineBarrier. The handles are filled in from the resources at execution, so imported
+            // resources can change every frame.
+            struct Barriers {
+                VkPipelineStageFlags srcStage = 0;
+                VkPipelineStageFlags dstStage = 0;
+                std::vector<VkImageMemoryBarrier> images;
+                std::vector<ResourceHandle> imageResources;
+                std::vector<VkBufferMemoryBarrier> buffers;
+                std::vector<ResourceHandle> bufferResources;
+            };
+
+            struct ScheduledPass {
+                uint32_t pass;
+                Barriers barriers;
+            };
+
+            struct Transients {
+                std::vector<VkImage> images;
+                std::vector<VkImageView> views;
+                std::vector<VkDeviceMemory> memories;
+            };
+
+            Device& device;
+            VkPhysicalDeviceMemoryProperties memoryProperties;
+
+            std::vector<Resource> resources;
+            std::vector<Pass> passes;
+            bool compiled = false;
+
+            std::vector<ScheduledPass> schedule;
+            Barriers finalBarriers;
+            Transients transients;
+            VkDeviceSize transientMemorySize = 0;
+            VkDeviceSize unaliasedMemorySize = 0;
+
+            ResourceHandle AddResource(const Resource& resource) {
+                resources.push_back(resource);
+                compiled = false;
+                return static_cast<ResourceHandle>(resources.size() - 1);
+            }
+
+            static UsageState GetUsageState(ResourceUsage usage) {
+                switch (usage) {
+                    case ResourceUsage::ColourAttachment:
+                        return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+                    case ResourceUsage::DepthAttachment:
+                        return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true};
+                    case ResourceUsage::DepthRead:
+                        return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false};
+                    case ResourceUsage::SampledFragment:
+                        return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+                    case ResourceUsage::SampledCompute:
+                        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+                    case ResourceUsage::StorageReadCompute:
+                        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false};
+                    case ResourceUsage::StorageWriteCompute:
+                        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true};
+                    case ResourceUsage::TransferSource:
+                        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+                    case ResourceUsage::TransferDestination:
+                        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+                    case ResourceUsage::VertexInput:
+                        return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+                    case ResourceUsage::IndirectRead:
+                        return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+                    case ResourceUsage::UniformRead:
+                        return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+                    case ResourceUsage::Present:
+                        return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false};
+                }
+                throw std::runtime_error("Unknown resource usage.");
+            }
+
+            static constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            // Walks back from the last pass. A pass lives if it has side effects, writes an imported resource or
+            // writes a transient a live pass after it reads.
+            std::vector<bool> CullPasses() const {
+                std::vector<bool> live(passes.size(), false);
+                std::vector<bool> needed(resources.size(), false);
+                for (size_t p = passes.size(); p-- > 0;) {
+                    const Pass& pass = passes[p];
+                    bool isLive = pass.sideEffects;
+                    for (auto& access : pass.accesses) {
+                        if (access.write && (resources[access.resource].imported || needed[access.resource])) {
+                            isLive = true;
+                        }
+                    }
+                    if (!isLive) {
+                        continue;
+                    }
+                    live[p] = true;
+                    for (auto& access : pass.accesses) {
+                        if (!access.write) {
+                            needed[access.resource] = true;
+                        }
+                    }
+                }
+                return live;
+            }
+
+            void ComputeLifetimes() {
+                for (auto& resource : resources) {
+                    if (!resource.imported) {
+                        resource.image = VK_NULL_HANDLE;
+                        resource.view = VK_NULL_HANDLE;
+                    }
+                    resource.firstUse = resource.lastUse = -1;
+                    resource.lastStage = 0;
+                    resource.lastWrites = 0;
+                    resource.aliases.clear();
+                }
+                for (int s = 0; s < static_cast<int>(schedule.size()); s++) {
+                    for (auto& access : passes[schedule[s].pass].accesses) {
+                        Resource& resource = resources[access.resource];
+                        UsageState state = GetUsageState(access.usage);
+                        if (resource.firstUse < 0) {
+                            resource.firstUse = s;
+                        }
+                        if (resource.lastUse != s) {
+                            resource.lastStage = 0;
+                            resource.lastWrites = 0;
+                        }
+                        resource.lastUse = s;
+                        resource.lastStage |= state.stage;
+                        resource.lastWrites |= state.access & WRITE_ACCESS;
+                    }
+                }
+            }
+
+            // Creates the used transients and places them in memory, biggest first, each at the lowest offset not
+            // overlapping a transient that is alive at the same time. One allocation per memory type.
+            void AllocateTransients() {
+                struct Placement {
+                    ResourceHandle resource;
+                    VkMemoryRequirements requirements;
+                    uint32_t memoryType;
+                    VkDeviceSize offset;
+                };
+                std::vector<Placement> placements;
+                unaliasedMemorySize = 0;
+                transientMemorySize = 0;
+
+                for (ResourceHandle r = 0; r < resources.size(); r++) {
+                    Resource& resource = resources[r];
+                    if (resource.imported || !resource.isImage || resource.firstUse < 0) {
+                        continue;
+                    }
+                    VkImageCreateInfo imageInfo{};
+                    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                    imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+                    imageInfo.mipLevels = 1;
+                    imageInfo.arrayLayers = 1;
+                    imageInfo.format = resource.desc.format;
+                    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    imageInfo.usage = resource.desc.usage;
+                    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                    if (vkCreateImage(device.GetDevice(), &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to create transient image.");
+                    }
+                    transients.images.push_back(resource.image);
+
+                    Placement placement{r, {}, 0, 0};
+                    vkGetImageMemoryRequirements(device.GetDevice(), resource.image, &placement.requirements);
+                    placement.memoryType = FindMemoryType(placement.requirements.memoryTypeBits);
+                    placements.push_back(placement);
+                    unaliasedMemorySize += placement.requirements.size;
+                }
+
+                std::sort(placements.begin(), placements.end(), [](const Placement& a, const Placement& b) { return a.requirements.size > b.requirements.size; });
+                std::vector<VkDeviceSize> memorySizes(memoryProperties.memoryTypeCount, 0);
+                for (size_t i = 0; i < placements.size(); i++) {
+                    Placement& placement = placements[i];
+                    const Resource& resource = resources[placement.resource];
+                    // Candidate offsets are the start of the memory and the end of every placed transient, the
+                    // lowest that clashes with nothing alive at the same time wins.
+                    std::vector<VkDeviceSize> candidates{0};
+                    for (size_t j = 0; j < i; j++) {
+                        if (placements[j].memoryType == placement.memoryType) {
+                            candidates.push_back(placements[j].offset + placements[j].requirements.size);
+                        }
+                    }
+                    std::sort(candidates.begin(), candidates.end());
+                    for (VkDeviceSize candidate : candidates) {
+                        VkDeviceSize alignment = placement.requirements.alignment;
+                        VkDeviceSize offset = (candidate + alignment - 1) / alignment * alignment;
+                        bool clashes = false;
+                        for (size_t j = 0; j < i && !clashes; j++) {
+                            const Placement& other = placements[j];
+                            const Resource& otherResource = resources[other.resource];
+                            bool sameTime = resource.firstUse <= otherResource.lastUse && otherResource.firstUse <= resource.lastUse;
+                            bool sameMemory = other.memoryType == placement.memoryType && offset < other.offset + other.requirements.size && other.offset < offset + placement.requirements.size;
+                            clashes = sameTime && sameMemory;
+                        }
+                        if (!clashes) {
+                            placement.offset = offset;
+                            break;
+                        }
+                    }
+                    memorySizes[placement.memoryType] = std::max(memorySizes[placement.memoryType], placement.offset + placement.requirements.size);
+                }
+
+                std::vector<VkDeviceMemory> memories(memoryProperties.memoryTypeCount, VK_NULL_HANDLE);
+                for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+                    if (memorySizes[type] == 0) {
+                        continue;
+                    }
+                    VkMemoryAllocateInfo allocInfo{};
+                    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                    allocInfo.allocationSize = memorySizes[type];
+                    allocInfo.memoryTypeIndex = type;
+                    if (vkAllocateMemory(device.GetDevice(), &allocInfo, nullptr, &memories[type]) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to allocate transient memory.");
+                    }
+                    transients.memories.push_back(memories[type]);
+                    transientMemorySize += memorySizes[type];
+                }
+
+                for (auto& placement : placements) {
+                    Resource& resource = resources[placement.resource];
+                    vkBindImageMemory(device.GetDevice(), resource.image, memories[placement.memoryType], placement.offset);
+
+                    VkImageViewCreateInfo viewInfo{};
+                    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                    viewInfo.image = resource.image;
+                    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                    viewInfo.format = resource.desc.format;
+                    viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+                    viewInfo.subresourceRange.levelCount = 1;
+                    viewInfo.subresourceRange.layerCount = 1;
+                    if (vkCreateImageView(device.GetDevice(), &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to create transient image view.");
+                    }
+                    transients.views.push_back(resource.view);
+
+                    for (auto& other : placements) {
+                        bool sameMemory = other.memoryType == placement.memoryType && placement.offset < other.offset + other.requirements.size && other.offset < placement.offset + placement.requirements.size;
+                        if (sameMemory) {
+                            resource.aliases.push_back(other.resource);
+                        }
+                    }
+                }
+            }
+
+            // Replays the schedule, tracking each resource's stage, access and layout. A barrier goes in wherever a
+            // pass reads after a write, writes after anything, or needs another layout. A transient's first use each
+            // frame starts from UNDEFINED and waits on the last use of everything sharing its memory. Earlier
+            // commands on the queue are in the barrier's scope, so this also covers the previous frame's use.
+            void BuildBarriers() {
+                std::vector<UsageState> states(resources.size());
+                std::vector<bool> used(resources.size(), false);
+                for (ResourceHandle r = 0; r < resources.size(); r++) {
+                    states[r] = resources[r].initialState;
+                }
+
+                for (auto& scheduled : schedule) {
+                    for (auto& access : passes[scheduled.pass].accesses) {
+                        Resource& resource = resources[access.resource];
+                        UsageState next = GetUsageState(access.usage);
+                        UsageState& current = states[access.resource];
+
+                        if (!resource.imported && resource.isImage && !used[access.resource]) {
+                            UsageState previous{0, 0, VK_IMAGE_LAYOUT_UNDEFINED, true};
+                            for (ResourceHandle alias : resource.aliases) {
+                                previous.stage |= resources[alias].lastStage;
+                                previous.access |= resources[alias].lastWrites;
+                            }
+                            AddBarrier(scheduled.barriers, access.resource, previous, next);
+                        }
+                        else if (current.write || access.write || current.layout != next.layout) {
+                            AddBarrier(scheduled.barriers, access.resource, current, next);
+                        }
+                        else {
+                            // Reads after reads in the same layout need nothing, but a later write must wait for all.
+                            current.stage |= next.stage;
+                            current.access |= next.access;
+                            used[access.resource] = true;
+                            continue;
+                        }
+                        current = next;
+                        current.write = access.write;
+                        used[access.resource] = true;
+                    }
+                }
+
+                for (ResourceHandle r = 0; r < resources.size(); r++) {
+                    const Resource& resource = resources[r];
+                    if (!resource.hasFinal) {
+                        continue;
+                    }
+                    if (states[r].layout != resource.finalState.layout || states[r].write) {
+                        AddBarrier(finalBarriers, r, states[r], resource.finalState);
+                    }
+                }
+            }
+
+            void AddBarrier(Barriers& barriers, ResourceHandle r, const UsageState& from, const UsageState& to) {
+                const Resource& resource = resources[r];
+                // Only writes need making available, a write after reads is an execution dependency alone.
+                VkAccessFlags srcAccess = from.write ? (from.access & WRITE_ACCESS) : 0;
+                barriers.srcStage |= from.stage != 0 ? from.stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                barriers.dstStage |= to.stage;
+
+                if (resource.isImage) {
+                    VkImageMemoryBarrier barrier{};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = srcAccess;
+                    barrier.dstAccessMask = to.access;
+                    barrier.oldLayout = from.layout;
+                    barrier.newLayout = to.layout;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.subresourceRange.aspectMask = resource.desc.aspect;
+                    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+                    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+                    barriers.images.push_back(barrier);
+                    barriers.imageResources.push_back(r);
+                }
+                else {
+                    VkBufferMemoryBarrier barrier{};
+                    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                    barrier.srcAccessMask = srcAccess;
+                    barrier.dstAccessMask = to.access;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.size = VK_WHOLE_SIZE;
+                    barriers.buffers.push_back(barrier);
+                    barriers.bufferResources.push_back(r);
+                }
+            }
+
+            void Issue(VkCommandBuffer commandBuffer, Barriers& barriers) {
+                if (barriers.images.empty() && barriers.buffers.empty()) {
+                    return;
+                }
+                for (size_t i = 0; i < barriers.images.size(); i++) {
+                    barriers.images[i].image = resources[barriers.imageResources[i]].image;
+                }
+                for (size_t i = 0; i < barriers.buffers.size(); i++) {
+                    barriers.buffers[i].buffer = resources[barriers.bufferResources[i]].buffer;
+                }
+                vkCmdPipelineBarrier(commandBuffer, barriers.srcStage, barriers.dstStage, 0, 0, nullptr,
+                    static_cast<uint32_t>(barriers.buffers.size()), barriers.buffers.data(),
+                    static_cast<uint32_t>(barriers.images.size()), barriers.images.data());
+            }
+
+            uint32_t FindMemoryType(uint32_t typeFilter) const {
+                for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+                    if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+                        return i;
+                    }
+                }
+                throw std::runtime_error("Failed to find memory for a transient image.");
+            }
+
+            static void DestroyTransients(VkDevice d, Transients& old) {
+                for (auto view : old.views) {
+                    vkDestroyImageView(d, view, nullptr);
+                }
+                for (auto image : old.images) {
+                    vkDestroyImage(d, image, nullptr);
+                }
+                for (auto memory : old.memories) {
+                    vkFreeMemory(d, memory, nullptr);
+                }
+                old = {};
+            }
+    };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// std
+#include <vector>
+
+namespace vkr {
+    // What decides which pipelines a single subpass render pass can be used with: the format and sample count of
+    // every attachment. Load and store ops and image layouts do not matter, so two passes with equal layouts are
+    // compatible and share pipelines, see PipelineLibrary.
+    struct RenderPassLayout {
+        struct Attachment {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+        };
+
+        std::vector<Attachment> colourAttachments;
+        // Format VK_FORMAT_UNDEFINED for a pass without depth.
+        Attachment depthAttachment;
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../../structs/instance.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vkr {
+    class Mesh;
+
+    // Everything the renderers need to draw one frame, copied out of the ECS by the simulation side. Each draw holds
+    // its mesh, so the mesh's arena range stays allocated for as long as a snapshot still refers to it, even after
+    // the entity that owned the mesh is gone.
+    struct RenderSnapshot {
+        struct Draw {
+            std::shared_ptr<Mesh> mesh;
+            VkBuffer vertexBuffer;
+            VkBuffer indexBuffer;
+            VkIndexType indexType;
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t vertexOffset;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+            // Depth of the nearest instance in clip space, 0 for 2D.
+            float depth;
+            // Kept from the previous snapshot while the draw and its instances are unchanged, so renderers can tell
+            // what needs recording again.
+            uint64_t revision;
+        };
+
+        std::vector<Draw> draws2D;
+        std::vector<Draw> draws3D;
+        // Every draw's instances, each draw's run starting at its firstInstance.
+        std::vector<InstanceData> instances;
+        // World to clip space of the first camera, identity when there is none.
+        qbn::mat<float, 4> viewProjection{1};
+        uint64_t frame = 0;
+        // Changes whenever any draw's revision does or a draw comes or goes. 0 only before the first extraction.
+        uint64_t revision = 0;
+
+        // Keeps the vectors' capacity so steady-state extraction does not allocate.
+        void Clear() {
+            draws2D.clear();
+            draws3D.clear();
+            instances.clear();
+        }
+    };
+
+    // What a renderer records one frame with.
+    struct RenderContext {
+        VkCommandBuffer commandBuffer;
+        uint32_t frameIndex;
+        const RenderSnapshot& snapshot;
+        // Holds snapshot.instances for this frame, bound at binding 1.
+        VkBuffer instanceBuffer;
+        // InstanceBuffer::GetGeneration of instanceBuffer.
+        uint64_t instanceGeneration;
+        // Set 0, the frame's CameraUniform at cameraOffset.
+        VkDescriptorSet frameSet;
+        uint32_t cameraOffset;
+    };
+}
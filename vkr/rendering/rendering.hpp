@@ -5,11 +5,21 @@
 #include "instance.hpp"
 #include "debugger.hpp"
 #include "surface.hpp"
+#include "pipeline_cache.hpp"
 #include "device.hpp"
 #include "swapchain.hpp"
 #include "pipeline.hpp"
+#include "compute_pipeline.hpp"
+#include "pipeline_library.hpp"
 #include "command_pool.hpp"
+#include "secondary_recorder.hpp"
 #include "buffers.hpp"
 #include "render.hpp"
+#include "render_graph.hpp"
+#include "render_snapshot.hpp"
 #include "mesh_pool.hpp"
+#include "instance_batcher.hpp"
+#include "instance_buffer.hpp"
+#include "uniform_ring.hpp"
+#include "gpu_culler.hpp"
 
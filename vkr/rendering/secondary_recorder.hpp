@@ -0,0 +1,246 @@
+#pragma once
+
+#include "../../thm/job_system.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace vkr {
+    // Mixes value's bytes into seed, for SecondaryRecorder keys.
+    template <class T>
+    inline uint64_t HashCombine(uint64_t seed, const T& value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t offset = 0; offset < sizeof(T); offset += sizeof(uint64_t)) {
+            uint64_t word = 0;
+            memcpy(&word, bytes + offset, std::min(sizeof(uint64_t), sizeof(T) - offset));
+            seed ^= word + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+
+    // Records the inside of the swapchain render pass on every worker at once. Each task records into its own
+    // secondary command buffer, and the primary executes them in task order so draw order is unchanged.
+    //
+    // There is one command pool per frame in flight per worker, plus one for the render thread. Tasks only ever run
+    // on workers and on the thread calling Record (see JobSystem::ParallelForIsolated), so with only the render
+    // thread recording, every pool has a single user. Pools are reset as a whole once the frame's fence has
+    // signalled. Recording therefore never locks, and its buffers are reused frame after frame instead of being
+    // allocated and freed.
+    //
+    // A task with a non-zero key is cached instead. Each frame slot keeps the last buffer recorded for each task
+    // index, in a pool of its own so any worker may re-record it. While the key stays the same the buffer is executed
+    // again without recording anything. A static scene then costs one vkCmdExecuteCommands per frame.
+    class SecondaryRecorder {
+        public:
+            SecondaryRecorder(Device& d, uint32_t framesInFlight, thm::JobSystem& j) : device{d}, jobs{j}, workerCount{static_cast<uint32_t>(j.GetThreadCount()) + 1}, pools(framesInFlight * workerCount), cache(framesInFlight) {
+                Device::QueueFamilyIndices queueFamilyIndices = device.FindQueueFamilies(device.GetPhysicalDevice());
+
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+                for (auto& pool : pools) {
+                    if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &pool.pool) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to create secondary command pool.");
+                    }
+                }
+            }
+
+            ~SecondaryRecorder() {
+                for (auto& pool : pools) {
+                    vkDestroyCommandPool(device.GetDevice(), pool.pool, nullptr);
+                }
+                for (auto& frame : cache) {
+                    for (auto& entry : frame) {
+                        if (entry.pool != VK_NULL_HANDLE) {
+                            vkDestroyCommandPool(device.GetDevice(), entry.pool, nullptr);
+                        }
+                    }
+                }
+            }
+
+            SecondaryRecorder(const SecondaryRecorder&) = delete;
+            SecondaryRecorder& operator=(const SecondaryRecorder&) = delete;
+
+            // Only call after the frame's fence has signalled.
+            void BeginFrame(uint32_t frameIndex) {
+                recordedCount = 0;
+                reusedCount = 0;
+                for (uint32_t w = 0; w < workerCount; w++) {
+                    WorkerPool& pool = pools[frameIndex * workerCount + w];
+                    if (pool.used > 0) {
+                        vkResetCommandPool(device.GetDevice(), pool.pool, 0);
+                        pool.used = 0;
+                    }
+                }
+            }
+
+            // Calls record(commandBuffer, task) for every task in [0, taskCount) across the workers, each into a
+            // secondary that continues renderPass with the viewport and scissor already set, then executes them in
+            // order into primary. The render pass must have been begun with
+            // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Call from the render thread, outside the job pool, it only
+            // ever runs its own tasks while waiting so recording is never stuck behind simulation jobs.
+            //
+            // key(task) identifies everything record would put in the buffer, render pass and extent aside. A task
+            // whose key matches the one its cached buffer was recorded with is not recorded again, 0 never matches.
+            // renderPassGeneration must change whenever renderPass is recreated, its handle may be reused.
+            template <class K, class F>
+            void Record(VkCommandBuffer primary, uint32_t frameIndex, VkRenderPass renderPass, uint64_t renderPassGeneration, VkFramebuffer framebuffer, VkExtent2D extent, size_t taskCount, K&& key, F&& record) {
+                if (taskCount == 0) {
+                    return;
+                }
+                secondaries.resize(taskCount);
+                std::vector<CachedTask>& cached = cache[frameIndex];
+                if (cached.size() < taskCount) {
+                    cached.resize(taskCount);
+                }
+
+                jobs.ParallelForIsolated(taskCount, 1, [&](size_t begin, size_t end) {
+                    int worker = jobs.GetWorkerIndex();
+                    WorkerPool& pool = pools[frameIndex * workerCount + (worker < 0 ? workerCount - 1 : static_cast<uint32_t>(worker))];
+                    for (size_t task = begin; task < end; task++) {
+                        uint64_t taskKey = key(task);
+                        if (taskKey == 0) {
+                            VkCommandBuffer commandBuffer = Acquire(pool);
+                            Begin(commandBuffer, renderPass, framebuffer, extent, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+                            record(commandBuffer, task);
+                            End(commandBuffer);
+                            secondaries[task] = commandBuffer;
+                            recordedCount.fetch_add(1, std::memory_order_relaxed);
+                            continue;
+                        }
+
+                        taskKey = HashCombine(HashCombine(taskKey, renderPassGeneration), extent);
+                        CachedTask& entry = cached[task];
+                        if (entry.key != taskKey || entry.buffer == VK_NULL_HANDLE) {
+                            // The framebuffer is left out, so the buffer stays valid for every swapchain image.
+                            VkCommandBuffer commandBuffer = AcquireCached(entry);
+                            Begin(commandBuffer, renderPass, VK_NULL_HANDLE, extent, 0);
+                            record(commandBuffer, task);
+                            End(commandBuffer);
+                            entry.key = taskKey;
+                            recordedCount.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        else {
+                            reusedCount.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        secondaries[task] = entry.buffer;
+                    }
+                });
+                vkCmdExecuteCommands(primary, static_cast<uint32_t>(taskCount), secondaries.data());
+            }
+
+            // Tasks recorded and tasks reused from the cache since the last BeginFrame.
+            uint32_t GetRecordedCount() const {
+                return recordedCount.load(std::memory_order_relaxed);
+            }
+
+            uint32_t GetReusedCount() const {
+                return reusedCount.load(std::memory_order_relaxed);
+            }
+
+        private:
+            // Padded to a cache line, neighbouring workers write their counts at the same time.
+            struct alignas(64) WorkerPool {
+                VkCommandPool pool = VK_NULL_HANDLE;
+                std::vector<VkCommandBuffer> buffers;
+                uint32_t used = 0;
+            };
+
+            // Only ever touched by the one task with its index, whichever worker runs it.
+            struct alignas(64) CachedTask {
+                VkCommandPool pool = VK_NULL_HANDLE;
+                VkCommandBuffer buffer = VK_NULL_HANDLE;
+                uint64_t key = 0;
+            };
+
+            Device& device;
+            thm::JobSystem& jobs;
+            uint32_t workerCount;
+            std::vector<WorkerPool> pools;
+            std::vector<VkCommandBuffer> secondaries;
+            // Per frame in flight, per task index.
+            std::vector<std::vector<CachedTask>> cache;
+            std::atomic<uint32_t> recordedCount{0};
+            std::atomic<uint32_t> reusedCount{0};
+
+            VkCommandBuffer Acquire(WorkerPool& pool) {
+                if (pool.used == pool.buffers.size()) {
+                    VkCommandBufferAllocateInfo allocInfo{};
+                    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                    allocInfo.commandPool = pool.pool;
+                    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                    allocInfo.commandBufferCount = 1;
+
+                    VkCommandBuffer commandBuffer;
+                    if (vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to allocate secondary command buffer.");
+                    }
+                    pool.buffers.push_back(commandBuffer);
+                }
+                return pool.buffers[pool.used++];
+            }
+
+            // Creates the entry's pool on first use, after that resets it so the buffer can be recorded again.
+            VkCommandBuffer AcquireCached(CachedTask& entry) {
+                if (entry.pool != VK_NULL_HANDLE) {
+                    vkResetCommandPool(device.GetDevice(), entry.pool, 0);
+                    return entry.buffer;
+                }
+
+                Device::QueueFamilyIndices queueFamilyIndices = device.FindQueueFamilies(device.GetPhysicalDevice());
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+                if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &entry.pool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create cached command pool.");
+                }
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = entry.pool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandBufferCount = 1;
+                if (vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, &entry.buffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate cached command buffer.");
+                }
+                return entry.buffer;
+            }
+
+            // Secondaries inherit no dynamic state from the primary, so each sets its own viewport and scissor.
+            static void Begin(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent, VkCommandBufferUsageFlags flags) {
+                VkCommandBufferInheritanceInfo inheritanceInfo{};
+                inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                inheritanceInfo.renderPass = renderPass;
+                inheritanceInfo.subpass = 0;
+                inheritanceInfo.framebuffer = framebuffer;
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
+                if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to begin secondary command buffer.");
+                }
+
+                VkViewport viewport{};
+                viewport.width = static_cast<float>(extent.width);
+                viewport.height = static_cast<float>(extent.height);
+                viewport.maxDepth = 1.0f;
+                VkRect2D scissor{ {0,0}, extent };
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            }
+
+            static void End(VkCommandBuffer commandBuffer) {
+                if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to record secondary command buffer.");
+                }
+            }
+    };
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+
+namespace vkr {
+    // Ring allocator over one persistently mapped staging buffer. Space is handed out at the head and given back
+    // from the tail in the order it was handed out, once the GPU has finished the copies reading from it.
+    // Positions are monotonic byte counts, the buffer offset is position % capacity, so capacity must be a multiple
+    // of ALIGNMENT.
+    class StagingRing {
+        public:
+            static constexpr VkDeviceSize ALIGNMENT = 16;
+
+            StagingRing(VkDeviceSize c) : capacity{c} {
+
+            }
+
+            // Reserves size bytes and returns the buffer offset, or false if the ring is too full right now.
+            // A range never wraps, the tail end of the buffer is skipped instead.
+            bool Allocate(VkDeviceSize size, VkDeviceSize& offset) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (size > capacity) {
+                    return false;
+                }
+
+                uint64_t start = (head + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+                if (start % capacity + size > capacity) {
+                    start += capacity - start % capacity;
+                }
+                if (start + size - tail > capacity) {
+                    return false;
+                }
+
+                head = start + size;
+                offset = start % capacity;
+                return true;
+            }
+
+            // Everything handed out so far. Pass it to Release once the work using those ranges has finished.
+            uint64_t GetMark() {
+                std::lock_guard<std::mutex> lock(mtx);
+                return head;
+            }
+
+            void Release(uint64_t mark) {
+                std::lock_guard<std::mutex> lock(mtx);
+                tail = std::max(tail, mark);
+            }
+
+            VkDeviceSize GetUsed() {
+                std::lock_guard<std::mutex> lock(mtx);
+                return head - tail;
+            }
+
+            VkDeviceSize GetCapacity() const {
+                return capacity;
+            }
+
+        private:
+            VkDeviceSize capacity;
+            uint64_t head = 0;
+            uint64_t tail = 0;
+            std::mutex mtx;
+    };
+}
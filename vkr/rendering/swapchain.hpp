@@ -1,50 +1,77 @@
 #pragma once
 
+#include "image.hpp"
+#include "present_policy.hpp"
+#include "render_pass_layout.hpp"
+
 // std
 #include <vector>
 #include <cstdint>
 #include <limits>
 #include <algorithm>
+#include <mutex>
+#include <memory>
+#include <functional>
 
 namespace vkr {
     class Swapchain {
         public:
-            Swapchain(Window& w,  Surface& s, Device& d) : window{w}, surface{s}, device{d} {
+            Swapchain(Window& w,  Surface& s, Device& d, MemoryAllocator& a, PresentPolicy p = {}) : MAX_FRAMES_IN_FLIGHT{static_cast<int>(std::max(p.framesInFlight, 1u))}, window{w}, surface{s}, device{d}, allocator{a}, policy{p} {
                 CreateSwapchain();
                 CreateImageViews();
+                CreateDepthResources();
                 CreateRenderPass();
                 CreateFrameBuffers();
                 CreateSyncObjects();
             }
 
-            void RecreateSwapchain() {
-                auto extent = window.GetExtent();
-                while (extent.width == 0 || extent.height == 0) {
-                    extent = window.GetExtent();
-                    glfwWaitEvents();
-                }
-
-                vkDeviceWaitIdle(device.GetDevice());
-
-                DestroySyncObjects();
-
-                for (auto framebuffer : swapchainFramebuffers) {
-                    vkDestroyFramebuffer(device.GetDevice(), framebuffer, nullptr);
-                }
-
-                vkDestroyRenderPass(device.GetDevice(), renderpass, nullptr);
-
-                for (auto imageView : swapchainImageViews) {
-                    vkDestroyImageView(device.GetDevice(), imageView, nullptr);
-                }
-                
-                vkDestroySwapchainKHR(device.GetDevice(), swapchain, nullptr);
-
-                CreateSwapchain();
+            // Builds a new swapchain from the old one, which is retired rather than destroyed so presentation
+            // carries on while the images are replaced. The render pass is kept unless the surface format changed,
+            // the sync objects always are, and nothing waits for the device. Returns what destroys the old
+            // swapchain's resources, run it once every frame submitted so far has finished.
+            //
+            // Pipelines built against a replaced render pass are no longer compatible, which only happens when the
+            // surface format changes. GetRenderPassGeneration changes with it, VulkanRendering then has every
+            // renderer request its pipeline again.
+            std::function<void()> RecreateSwapchain() {
+                VkSwapchainKHR oldSwapchain = swapchain;
+                VkFormat oldFormat = format;
+                std::vector<VkFramebuffer> oldFramebuffers;
+                std::vector<VkImageView> oldImageViews;
+                std::vector<std::shared_ptr<Image>> oldDepthImages;
+                oldFramebuffers.swap(swapchainFramebuffers);
+                oldImageViews.swap(swapchainImageViews);
+                oldDepthImages.swap(depthImages);
+
+                CreateSwapchain(oldSwapchain);
                 CreateImageViews();
-                CreateRenderPass();
+                CreateDepthResources();
+                VkRenderPass oldRenderpass = VK_NULL_HANDLE;
+                if (format != oldFormat) {
+                    oldRenderpass = renderpass;
+                    CreateRenderPass();
+                }
                 CreateFrameBuffers();
-                CreateSyncObjects();
+                presentModeChanged = false;
+                // Fences of the old images say nothing about the new ones.
+                imagesInFlight.assign(swapchainImages.size(), VK_NULL_HANDLE);
+
+                VkDevice d = device.GetDevice();
+                return [=]() {
+                    for (auto framebuffer : oldFramebuffers) {
+                        vkDestroyFramebuffer(d, framebuffer, nullptr);
+                    }
+                    if (oldRenderpass != VK_NULL_HANDLE) {
+                        vkDestroyRenderPass(d, oldRenderpass, nullptr);
+                    }
+                    for (auto& depthImage : oldDepthImages) {
+                        depthImage->Destroy();
+                    }
+                    for (auto imageView : oldImageViews) {
+                        vkDestroyImageView(d, imageView, nullptr);
+                    }
+                    vkDestroySwapchainKHR(d, oldSwapchain, nullptr);
+                };
             }
 
             ~Swapchain() {
@@ -54,6 +81,8 @@ namespace vkr {
 
                 vkDestroyRenderPass(device.GetDevice(), renderpass, nullptr);
 
+                DestroyDepthResources();
+
                 for (auto imageView : swapchainImageViews) {
                     vkDestroyImageView(device.GetDevice(), imageView, nullptr);
                 }
@@ -71,9 +100,10 @@ namespace vkr {
                 return availableFormats[0];
             }
 
+            // The policy's mode if the surface supports it, FIFO always is.
             VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
                 for (const auto& availablePresentMode : availablePresentModes) {
-                    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+                    if (availablePresentMode == policy.presentMode) {
                         return availablePresentMode;
                     }
                 }
@@ -124,11 +154,11 @@ namespace vkr {
                 return details;
             }
 
-            void CreateSwapchain() {
+            void CreateSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE) {
                 Device::SwapchainSupportDetails swapchainSupport = QuerySwapChainSupport(device.GetPhysicalDevice());
 
                 VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapchainSupport.formats);
-                VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapchainSupport.presentModes);
+                presentMode = ChooseSwapPresentMode(swapchainSupport.presentModes);
                 VkExtent2D swapchainExtent = ChooseSwapExtent(swapchainSupport.capabilities);
 
                 uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
@@ -164,7 +194,7 @@ namespace vkr {
                 createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
                 createInfo.presentMode = presentMode;
                 createInfo.clipped = VK_TRUE;
-                createInfo.oldSwapchain = VK_NULL_HANDLE; // Later use this to handle window resizing by creating new swapchain
+                createInfo.oldSwapchain = oldSwapchain;
 
                 if (vkCreateSwapchainKHR(device.GetDevice(), &createInfo, nullptr, &swapchain) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to create swapchain.");
@@ -205,6 +235,45 @@ namespace vkr {
                 }
             }
 
+            // First of the candidates usable as an optimally tiled depth attachment, 32-bit float preferred.
+            VkFormat FindDepthFormat() {
+                const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM};
+                for (VkFormat candidate : candidates) {
+                    VkFormatProperties properties;
+                    vkGetPhysicalDeviceFormatProperties(device.GetPhysicalDevice(), candidate, &properties);
+                    if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+                        return candidate;
+                    }
+                }
+                throw std::runtime_error("Failed to find a supported depth format.");
+            }
+
+            // One depth image per swapchain image, sized to the swapchain. Depth is cleared on load and never stored,
+            // so on tilers it can live in lazily allocated memory that is never backed at all. They come from the
+            // shared MemoryAllocator like every other image and are only created here and on resize.
+            void CreateDepthResources() {
+                depthFormat = FindDepthFormat();
+
+                // Transient usage is only worth it with lazily allocated memory around.
+                const VkPhysicalDeviceMemoryProperties& memoryProperties = allocator.GetMemoryProperties();
+                bool lazy = false;
+                for (uint32_t t = 0; t < memoryProperties.memoryTypeCount; t++) {
+                    lazy = lazy || (memoryProperties.memoryTypes[t].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+                }
+
+                depthImages.resize(swapchainImages.size());
+                for (size_t i = 0; i < swapchainImages.size(); i++) {
+                    depthImages[i] = std::make_shared<Image>(device, allocator, extent.width, extent.height, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0), VK_IMAGE_ASPECT_DEPTH_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+                }
+            }
+
+            void DestroyDepthResources() {
+                for (auto& depthImage : depthImages) {
+                    depthImage->Destroy();
+                }
+                depthImages.clear();
+            }
+
             void CreateRenderPass() {
                 VkAttachmentDescription colourAttachment{};
                 colourAttachment.format = format;
@@ -213,28 +282,60 @@ namespace vkr {
                 colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
                 colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
                 colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-                colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+                // The render graph moves the image into and out of the attachment layout, the transition to present
+                // included.
+                colourAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                colourAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
                 VkAttachmentReference colourAttachmentRef{};
                 colourAttachmentRef.attachment = 0;
                 colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+                // Cleared every frame and thrown away at the end, nothing reads depth after the pass.
+                VkAttachmentDescription depthAttachment{};
+                depthAttachment.format = depthFormat;
+                depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+                depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference depthAttachmentRef{};
+                depthAttachmentRef.attachment = 1;
+                depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
                 VkSubpassDescription subpass{};
                 subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
                 subpass.colorAttachmentCount = 1;
                 subpass.pColorAttachments = &colourAttachmentRef;
-
+                subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+                // The clears wait for the previous use of the images: colour for the acquire, depth for the last
+                // frame's tests on the same image.
+                VkSubpassDependency dependency{};
+                dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+                dependency.dstSubpass = 0;
+                dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+                dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+                VkAttachmentDescription attachments[] = {colourAttachment, depthAttachment};
                 VkRenderPassCreateInfo renderpassInfo{};
                 renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-                renderpassInfo.attachmentCount = 1;
-                renderpassInfo.pAttachments = &colourAttachment;
+                renderpassInfo.attachmentCount = 2;
+                renderpassInfo.pAttachments = attachments;
                 renderpassInfo.subpassCount = 1;
                 renderpassInfo.pSubpasses = &subpass;
+                renderpassInfo.dependencyCount = 1;
+                renderpassInfo.pDependencies = &dependency;
 
                 if (vkCreateRenderPass(device.GetDevice(), &renderpassInfo, nullptr, &renderpass) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to create render pass.");
                 }
+                renderpassGeneration++;
             }
 
             void CreateFrameBuffers() {
@@ -242,13 +343,14 @@ namespace vkr {
 
                 for (size_t i = 0; i < swapchainImageViews.size(); i++) {
                     VkImageView attachments[] = {
-                        swapchainImageViews[i]
+                        swapchainImageViews[i],
+                        depthImages[i]->GetImageView()
                     };
 
                     VkFramebufferCreateInfo framebufferInfo{};
                     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
                     framebufferInfo.renderPass = renderpass;
-                    framebufferInfo.attachmentCount = 1;
+                    framebufferInfo.attachmentCount = 2;
                     framebufferInfo.pAttachments = attachments;
                     framebufferInfo.width = extent.width;
                     framebufferInfo.height = extent.height;
@@ -296,8 +398,12 @@ namespace vkr {
                 }
             }
 
-            VkResult AcquireNextImage(uint32_t* imageIndex) {
+            // Blocks until the GPU has finished the last frame submitted from the current frame slot.
+            void WaitForFrame() {
                 vkWaitForFences(device.GetDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+            }
+
+            VkResult AcquireNextImage(uint32_t* imageIndex) {
                 VkResult result = vkAcquireNextImageKHR(device.GetDevice(), swapchain, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, imageIndex);
                 return result;
             }
@@ -325,8 +431,11 @@ namespace vkr {
                 submitInfo.pSignalSemaphores = signalSemaphores;
 
                 vkResetFences(device.GetDevice(), 1, &inFlightFences[currentFrame]);
-                if (vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-                    throw std::runtime_error("Failed to submit draw command buffer.");
+                {
+                    std::lock_guard<std::mutex> lock(device.GetQueueMutex());
+                    if (vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to submit draw command buffer.");
+                    }
                 }
 
                 VkPresentInfoKHR presentInfo{};
@@ -340,7 +449,11 @@ namespace vkr {
 
                 presentInfo.pImageIndices = imageIndex;
 
-                auto result = vkQueuePresentKHR(device.GetPresentQueue(), &presentInfo);
+                VkResult result;
+                {
+                    std::lock_guard<std::mutex> lock(device.GetQueueMutex());
+                    result = vkQueuePresentKHR(device.GetPresentQueue(), &presentInfo);
+                }
 
                 currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -355,6 +468,14 @@ namespace vkr {
                 return swapchainImages;
             }
 
+            VkImage GetSwapchainImage(uint32_t index) const {
+                return swapchainImages[index];
+            }
+
+            VkImageView GetSwapchainImageView(uint32_t index) const {
+                return swapchainImageViews[index];
+            }
+
             std::vector<VkImageView> GetSwapchainImageViews() {
                 return swapchainImageViews;
             }
@@ -363,6 +484,19 @@ namespace vkr {
                 return renderpass;
             }
 
+            // What pipelines used in the render pass must be compatible with, see PipelineLibrary.
+            RenderPassLayout GetRenderPassLayout() const {
+                RenderPassLayout layout;
+                layout.colourAttachments.push_back({format, VK_SAMPLE_COUNT_1_BIT});
+                layout.depthAttachment = {depthFormat, VK_SAMPLE_COUNT_1_BIT};
+                return layout;
+            }
+
+            // Bumped each time the render pass is recreated, for caches that must not key on the handle.
+            uint64_t GetRenderPassGeneration() const {
+                return renderpassGeneration;
+            }
+
             VkFramebuffer& GetFramebuffer(int index) {
                 return swapchainFramebuffers[index];
             }
@@ -371,6 +505,31 @@ namespace vkr {
                 return format;
             }
 
+            // Takes effect when the swapchain is next recreated, which Render does at the end of the current frame.
+            void SetPresentMode(VkPresentModeKHR mode) {
+                if (mode != policy.presentMode) {
+                    policy.presentMode = mode;
+                    presentModeChanged = true;
+                }
+            }
+
+            bool IsPresentModeChanged() const {
+                return presentModeChanged;
+            }
+
+            // The mode in use, which may be FIFO when the requested one is unsupported.
+            VkPresentModeKHR GetPresentMode() const {
+                return presentMode;
+            }
+
+            PresentPolicy& GetPresentPolicy() {
+                return policy;
+            }
+
+            VkFormat GetDepthFormat() const {
+                return depthFormat;
+            }
+
             VkExtent2D& GetExtent() {
                 return extent;
             }
@@ -395,12 +554,17 @@ namespace vkr {
                 return surface;
             }
 
-            int MAX_FRAMES_IN_FLIGHT = 2;
+            // From the policy, fixed for the swapchain's lifetime.
+            const int MAX_FRAMES_IN_FLIGHT;
 
         private:
             Window& window;
             Surface& surface;
             Device& device;
+            MemoryAllocator& allocator;
+            PresentPolicy policy;
+            VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            bool presentModeChanged = false;
 
             VkSwapchainKHR swapchain;
 
@@ -410,7 +574,11 @@ namespace vkr {
             std::vector<VkImage> swapchainImages;
             std::vector<VkImageView> swapchainImageViews;
 
+            VkFormat depthFormat;
+            std::vector<std::shared_ptr<Image>> depthImages;
+
             VkRenderPass renderpass;
+            uint64_t renderpassGeneration = 0;
 
             std::vector<VkFramebuffer> swapchainFramebuffers;
 
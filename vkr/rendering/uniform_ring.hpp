@@ -0,0 +1,100 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace vkr {
+    // One host visible, persistently mapped uniform buffer split into a region per frame in flight, each holding up
+    // to elementsPerFrame elements. Push copies an element into the current frame's region and returns the dynamic
+    // offset to bind it with, the single descriptor set is written once and never updated. A frame's region is only
+    // reused after its fence has signalled, so writes never race the shaders reading the previous contents.
+    class UniformRing {
+        public:
+            UniformRing(Device& d, BufferManager& bm, uint32_t framesInFlight, VkDeviceSize es, uint32_t epf = 16) : device{d}, elementSize{es}, elementsPerFrame{epf}, heads(framesInFlight, 0) {
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(device.GetPhysicalDevice(), &properties);
+                VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+
+                uint32_t elementCount = framesInFlight * elementsPerFrame;
+                buffer = bm.CreateBuffer(elementSize, elementCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, alignment);
+                if (buffer->Map() != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to map uniform ring.");
+                }
+
+                setLayout = Pipeline::CreateFrameSetLayout(device);
+
+                VkDescriptorPoolSize poolSize{};
+                poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                poolSize.descriptorCount = 1;
+                VkDescriptorPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolInfo.maxSets = 1;
+                poolInfo.poolSizeCount = 1;
+                poolInfo.pPoolSizes = &poolSize;
+                if (vkCreateDescriptorPool(device.GetDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create uniform descriptor pool.");
+                }
+
+                VkDescriptorSetAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                allocInfo.descriptorPool = descriptorPool;
+                allocInfo.descriptorSetCount = 1;
+                allocInfo.pSetLayouts = &setLayout;
+                if (vkAllocateDescriptorSets(device.GetDevice(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate uniform descriptor set.");
+                }
+
+                // The range is one element, the dynamic offset picks which.
+                VkDescriptorBufferInfo bufferInfo{buffer->GetBuffer(), 0, elementSize};
+                VkWriteDescriptorSet write{};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = descriptorSet;
+                write.dstBinding = 0;
+                write.descriptorCount = 1;
+                write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                write.pBufferInfo = &bufferInfo;
+                vkUpdateDescriptorSets(device.GetDevice(), 1, &write, 0, nullptr);
+            }
+
+            ~UniformRing() {
+                vkDestroyDescriptorPool(device.GetDevice(), descriptorPool, nullptr);
+                vkDestroyDescriptorSetLayout(device.GetDevice(), setLayout, nullptr);
+            }
+
+            UniformRing(const UniformRing&) = delete;
+            UniformRing& operator=(const UniformRing&) = delete;
+
+            // Only call after the frame's fence has signalled, before the first Push of the frame.
+            void BeginFrame(uint32_t frameIndex) {
+                heads[frameIndex] = 0;
+            }
+
+            // Copies elementSize bytes from data and returns the dynamic offset of the copy.
+            uint32_t Push(uint32_t frameIndex, const void* data) {
+                if (heads[frameIndex] >= elementsPerFrame) {
+                    throw std::runtime_error("Uniform ring is full for this frame.");
+                }
+                VkDeviceSize offset = (static_cast<VkDeviceSize>(frameIndex) * elementsPerFrame + heads[frameIndex]++) * buffer->GetAlignmentSize();
+                buffer->WriteToBuffer(const_cast<void*>(data), elementSize, offset);
+                return static_cast<uint32_t>(offset);
+            }
+
+            VkDescriptorSet GetDescriptorSet() const {
+                return descriptorSet;
+            }
+
+        private:
+            Device& device;
+            VkDeviceSize elementSize;
+            uint32_t elementsPerFrame;
+            // Next free element of each frame's region.
+            std::vector<uint32_t> heads;
+
+            std::shared_ptr<Buffer> buffer;
+            VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+}
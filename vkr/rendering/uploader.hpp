@@ -0,0 +1,264 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "staging_ring.hpp"
+#include "frame_resources.hpp"
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkr {
+    // Streams data into device local buffers from its own thread, on the dedicated transfer queue when the device
+    // has one and on the graphics queue otherwise. Everything queued while a batch is on the GPU goes into the next
+    // batch, so a level's worth of meshes costs a handful of submits and the render loop never waits on any of them.
+    //
+    // With a dedicated transfer family, ownership of each destination range is released by the transfer queue and
+    // acquired by the graphics queue in the next frame recorded after the batch's fence signals. An upload's
+    // onResident waits for that acquire to be recorded, so nothing draws from the range early.
+    class Uploader {
+        public:
+            static constexpr VkDeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024;
+
+            Uploader(Device& d, MemoryAllocator& a) : device{d}, allocator{a} {
+                stagingBuffer = std::make_shared<Buffer>(device, allocator, 1, static_cast<uint32_t>(STAGING_RING_SIZE), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1);
+                stagingBuffer->Map();
+
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex = device.GetTransferFamily();
+                if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create transfer command pool.");
+                }
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = commandPool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = 1;
+                if (vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate transfer command buffer.");
+                }
+
+                VkFenceCreateInfo fenceInfo{};
+                fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+                if (vkCreateFence(device.GetDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create transfer fence.");
+                }
+
+                uploadThread = std::thread(&Uploader::UploadThread, this);
+            }
+
+            ~Uploader() {
+                Stop();
+                vkDestroyFence(device.GetDevice(), fence, nullptr);
+                vkDestroyCommandPool(device.GetDevice(), commandPool, nullptr);
+            }
+
+            Uploader(const Uploader&) = delete;
+            Uploader& operator=(const Uploader&) = delete;
+
+            // Copies data into staging memory straight away and queues the GPU copy into dst. Once the copy has
+            // landed and been handed to the graphics queue, onResident runs on the render thread. Falls back to a
+            // one-off staging buffer when the ring is full.
+            void Upload(const void* data, VkDeviceSize size, std::shared_ptr<Buffer> dst, VkDeviceSize dstOffset = 0, std::function<void()> onResident = {}) {
+                PendingUpload upload{nullptr, 0, std::move(dst), dstOffset, size, std::move(onResident)};
+
+                {
+                    std::lock_guard<std::mutex> lock(pendingMutex);
+                    if (stagingRing.Allocate(size, upload.srcOffset)) {
+                        memcpy(static_cast<char*>(stagingBuffer->GetAllocation().mapped) + upload.srcOffset, data, size);
+                    }
+                    else {
+                        upload.src = std::make_shared<Buffer>(device, allocator, 1, static_cast<uint32_t>(size), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1);
+                        upload.src->Map();
+                        upload.src->WriteToBuffer(const_cast<void*>(data), size);
+                    }
+                    pending.push_back(std::move(upload));
+                }
+                pendingCv.notify_one();
+            }
+
+            // Graphics side of the hand-over. Records the acquire barriers (or, on a shared queue, one memory
+            // barrier) for every batch that finished since the last call, then runs their onResident. Call
+            // outside a render pass, before anything that draws.
+            void RecordAcquires(VkCommandBuffer graphicsCommandBuffer, FrameResources& frame) {
+                std::vector<PendingUpload> uploads;
+                {
+                    std::lock_guard<std::mutex> lock(completedMutex);
+                    if (completed.empty()) {
+                        return;
+                    }
+                    uploads.swap(completed);
+                }
+
+                if (device.HasDedicatedTransferQueue()) {
+                    std::vector<VkBufferMemoryBarrier> barriers;
+                    barriers.reserve(uploads.size());
+                    for (auto& upload : uploads) {
+                        VkBufferMemoryBarrier barrier = OwnershipBarrier(upload);
+                        barrier.srcAccessMask = 0;
+                        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+                        barriers.push_back(barrier);
+                    }
+                    vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+                }
+                else {
+                    // The copies went through this same queue in an earlier submission.
+                    VkMemoryBarrier barrier{};
+                    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+                    vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+                }
+
+                for (auto& upload : uploads) {
+                    frame.Retain(upload.dst);
+                    if (upload.onResident) {
+                        upload.onResident();
+                    }
+                }
+            }
+
+            // Finishes whatever is queued and stops the upload thread. Later uploads are dropped.
+            void Stop() {
+                {
+                    std::lock_guard<std::mutex> lock(pendingMutex);
+                    if (finish) {
+                        return;
+                    }
+                    finish = true;
+                }
+                pendingCv.notify_all();
+                if (uploadThread.joinable()) {
+                    uploadThread.join();
+                }
+            }
+
+            uint64_t GetSubmittedBatches() const {
+                return submittedBatches.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct PendingUpload {
+                // Null when the data sits in the staging ring at srcOffset.
+                std::shared_ptr<Buffer> src;
+                VkDeviceSize srcOffset;
+                std::shared_ptr<Buffer> dst;
+                VkDeviceSize dstOffset;
+                VkDeviceSize size;
+                std::function<void()> onResident;
+            };
+
+            Device& device;
+            MemoryAllocator& allocator;
+
+            std::shared_ptr<Buffer> stagingBuffer;
+            StagingRing stagingRing{STAGING_RING_SIZE};
+
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+
+            std::vector<PendingUpload> pending;
+            bool finish = false;
+            std::mutex pendingMutex;
+            std::condition_variable pendingCv;
+
+            std::vector<PendingUpload> completed;
+            std::mutex completedMutex;
+
+            std::atomic<uint64_t> submittedBatches{0};
+            std::thread uploadThread;
+
+            VkBufferMemoryBarrier OwnershipBarrier(const PendingUpload& upload) const {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex = device.GetTransferFamily();
+                barrier.dstQueueFamilyIndex = device.GetGraphicsFamily();
+                barrier.buffer = upload.dst->GetBuffer();
+                barrier.offset = upload.dstOffset;
+                barrier.size = upload.size;
+                return barrier;
+            }
+
+            void UploadThread() {
+                while (true) {
+                    std::vector<PendingUpload> batch;
+                    uint64_t mark;
+                    {
+                        std::unique_lock<std::mutex> lock(pendingMutex);
+                        pendingCv.wait(lock, [this]{ return finish || !pending.empty(); });
+                        if (pending.empty()) {
+                            return;
+                        }
+                        batch.swap(pending);
+                        mark = stagingRing.GetMark();
+                    }
+
+                    Submit(batch);
+
+                    // Only this thread waits on the transfer, rendering carries on meanwhile.
+                    vkWaitForFences(device.GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+                    vkResetFences(device.GetDevice(), 1, &fence);
+                    stagingRing.Release(mark);
+
+                    std::lock_guard<std::mutex> lock(completedMutex);
+                    for (auto& upload : batch) {
+                        upload.src.reset();
+                        completed.push_back(std::move(upload));
+                    }
+                }
+            }
+
+            void Submit(const std::vector<PendingUpload>& batch) {
+                vkResetCommandBuffer(commandBuffer, 0);
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+                for (auto& upload : batch) {
+                    VkBufferCopy copyRegion{};
+                    copyRegion.srcOffset = upload.srcOffset;
+                    copyRegion.dstOffset = upload.dstOffset;
+                    copyRegion.size = upload.size;
+                    VkBuffer src = upload.src ? upload.src->GetBuffer() : stagingBuffer->GetBuffer();
+                    vkCmdCopyBuffer(commandBuffer, src, upload.dst->GetBuffer(), 1, &copyRegion);
+                }
+
+                if (device.HasDedicatedTransferQueue()) {
+                    std::vector<VkBufferMemoryBarrier> barriers;
+                    barriers.reserve(batch.size());
+                    for (auto& upload : batch) {
+                        VkBufferMemoryBarrier barrier = OwnershipBarrier(upload);
+                        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                        barrier.dstAccessMask = 0;
+                        barriers.push_back(barrier);
+                    }
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+                }
+
+                vkEndCommandBuffer(commandBuffer);
+
+                VkSubmitInfo submitInfo{};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+
+                std::lock_guard<std::mutex> lock(device.GetTransferQueueMutex());
+                if (vkQueueSubmit(device.GetTransferQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to submit upload batch.");
+                }
+                submittedBatches.fetch_add(1, std::memory_order_relaxed);
+            }
+    };
+}
@@ -36,6 +36,11 @@ namespace vkr {
                 return {static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT)};
             }
 
+            // A zero sized framebuffer, nothing can be presented until the window is restored.
+            bool IsMinimised() {
+                return WIDTH == 0 || HEIGHT == 0;
+            }
+
             bool WasWindowResized() { return framebufferResized; }
             void ResetWindowResizedFlag() { framebufferResized = false; }
         private:
@@ -45,6 +50,6 @@ namespace vkr {
 
         GLFWwindow* window;
 
-        bool framebufferResized;
+        bool framebufferResized = false;
     }; 
 }
\ No newline at end of file
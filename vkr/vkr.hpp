@@ -2,11 +2,17 @@
 
 #include "rendering/rendering.hpp"
 #include "renderers/renderers.hpp"
+#include "../ecs/ecs.hpp"
+#include "../thm/triple_buffer.hpp"
 
 // std
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <iostream>
+#include <limits>
 #include <memory>
-#include <mutex>
+#include <tuple>
 
 namespace vkr {
     class VulkanRendering {
@@ -15,44 +21,141 @@ namespace vkr {
                 Clean();
             }
 
-            void Init() {
+            // Where the pipeline cache is kept between runs, relative to the working directory like the shaders.
+            static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+            // Frames between pipeline cache saves, a save only writes when new pipelines were compiled. Saves run on a
+            // pipeline library thread, only the one in Clean blocks.
+            static constexpr uint64_t PIPELINE_CACHE_SAVE_INTERVAL = 3600;
+            static constexpr double MINIMISED_WAIT_SECONDS = 0.1;
+
+            void Init(PresentPolicy policy = {}) {
+                initStart = std::chrono::steady_clock::now();
                 window = std::make_shared<Window>();
                 validationLayers = std::make_shared<ValidationLayers>();
                 instance = std::make_shared<Instance>(*validationLayers);
                 debugger = std::make_shared<Debugger>(*validationLayers, *instance);
                 surface = std::make_shared<Surface>(*window, *instance);
                 device = std::make_shared<Device>(*window, *validationLayers, *instance, *surface);
-                swapchain = std::make_shared<Swapchain>(*window, *surface, *device);
+                device->GetPipelineCache().Load(PIPELINE_CACHE_PATH);
+                memoryAllocator = std::make_shared<MemoryAllocator>(*device);
+                swapchain = std::make_shared<Swapchain>(*window, *surface, *device, *memoryAllocator, policy);
+                pipelineLibrary = std::make_shared<PipelineLibrary>(*device);
                 command_pool = std::make_shared<CommandPool>(*device, *swapchain);
                 render = std::make_shared<Render>(*swapchain, *command_pool);
-                bufferManager = std::make_shared<BufferManager>(*device, *command_pool);
+                bufferManager = std::make_shared<BufferManager>(*device, *command_pool, *memoryAllocator);
                 mesh_pool = std::make_shared<MeshPool>(bufferManager);
+                instanceBuffer = std::make_shared<InstanceBuffer>(*bufferManager, static_cast<uint32_t>(swapchain->MAX_FRAMES_IN_FLIGHT));
+                frameUniforms = std::make_shared<UniformRing>(*device, *bufferManager, static_cast<uint32_t>(swapchain->MAX_FRAMES_IN_FLIGHT), sizeof(CameraUniform));
+                frameGraph = std::make_shared<RenderGraph>(*device);
+                BuildFrameGraph();
+                renderPassGeneration = swapchain->GetRenderPassGeneration();
             }
 
             void Run() {
+                // While minimised block on events instead of spinning, the timeout keeps the caller's loop turning.
+                if (window->IsMinimised()) {
+                    glfwWaitEventsTimeout(MINIMISED_WAIT_SECONDS);
+                    return;
+                }
+                // Late pacing blocks on the GPU first so the input read next is as recent as possible when drawn.
+                if (swapchain->GetPresentPolicy().latePacing) {
+                    render->WaitForFrame();
+                }
                 glfwPollEvents();
+                render->MarkInputSampled();
+                // Whatever the simulation published last, possibly the same snapshot as last frame.
+                const RenderSnapshot& snapshot = snapshots.Acquire();
+
                 auto commandBuffer = render->BeginFrame();
-                render->BeginSwapchainRenderpass(commandBuffer);
-                for (auto& renderer : renderers) {
-                    renderer->Render(commandBuffer);
+                if (commandBuffer == nullptr) {
+                    return;
+                }
+                // A replaced render pass (the surface format changed) is incompatible with every pipeline so far.
+                // Renderers ask for new ones, the old pipelines live on until this frame has finished.
+                if (swapchain->GetRenderPassGeneration() != renderPassGeneration) {
+                    renderPassGeneration = swapchain->GetRenderPassGeneration();
+                    for (auto& renderer : renderers) {
+                        render->GetCurrentFrameResources().Retain(renderer->RequestPipeline());
+                    }
+                }
+
+                // Pipelines that finished compiling since last frame are used from this frame on. Read before
+                // processing, so no pending compiles means every renderer has its pipeline this frame.
+                bool compiling = pipelineLibrary->GetPendingCompiles() > 0;
+                pipelineLibrary->ProcessCompleted();
+
+                // The snapshot slot may be refilled by the simulation while this frame is still on the GPU. The
+                // meshes are gathered once per snapshot revision, a static scene retains the same list every frame.
+                auto& frame = render->GetCurrentFrameResources();
+                if (!sceneMeshes || snapshot.revision != sceneMeshesRevision) {
+                    sceneMeshes = std::make_shared<std::vector<std::shared_ptr<Mesh>>>();
+                    for (auto& draw : snapshot.draws2D) {
+                        sceneMeshes->push_back(draw.mesh);
+                    }
+                    for (auto& draw : snapshot.draws3D) {
+                        sceneMeshes->push_back(draw.mesh);
+                    }
+                    sceneMeshesRevision = snapshot.revision;
                 }
-                render->EndSwapchainRenderpass(commandBuffer);
+                frame.Retain(sceneMeshes);
+
+                // Meshes whose uploads landed since last frame become resident here and show up in later snapshots.
+                bufferManager->RecordUploads(commandBuffer, frame);
+
+                const uint32_t frameIndex = static_cast<uint32_t>(swapchain->GetCurrentFrameIndex());
+                // Per frame only matrices are written, the instances' and the camera's.
+                frameUniforms->BeginFrame(frameIndex);
+                CameraUniform camera{snapshot.viewProjection};
+                uint32_t cameraOffset = frameUniforms->Push(frameIndex, &camera);
+                VkBuffer instances = instanceBuffer->Write(frameIndex, snapshot.instances, snapshot.revision);
+                RenderContext context{commandBuffer, frameIndex, snapshot, instances, instanceBuffer->GetGeneration(frameIndex), frameUniforms->GetDescriptorSet(), cameraOffset};
+                uint32_t imageIndex = swapchain->GetCurrentImageIndex();
+                frameGraph->SetImage(swapchainImage, swapchain->GetSwapchainImage(imageIndex), swapchain->GetSwapchainImageView(imageIndex));
+                frameContext = &context;
+                frameGraph->Execute(commandBuffer);
+                frameContext = nullptr;
                 render->EndFrame();
 
-                vkDeviceWaitIdle(device->GetDevice());
+                ++renderedFrames;
+                if (timeToFirstFrameMilliseconds == 0.0 && !compiling && !renderers.empty()) {
+                    // The first frame drawn with every renderer's pipeline, so it covers device setup and all the
+                    // pipeline compiles. Compare a run without pipeline_cache.bin (cold) against the next (warm).
+                    timeToFirstFrameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initStart).count();
+                    size_t cacheSize = device->GetPipelineCache().GetLoadedSize();
+                    std::cout << "First frame after " << timeToFirstFrameMilliseconds << " ms, pipeline cache " << (cacheSize > 0 ? "warm (" + std::to_string(cacheSize) + " bytes)" : std::string("cold")) << std::endl;
+                }
+                ReportTiming();
+                if (renderedFrames % PIPELINE_CACHE_SAVE_INTERVAL == 0) {
+                    pipelineLibrary->RequestCacheSave();
+                }
             }
 
             void Clean() {
                 render.reset();
-                for (auto& buffer : bufferManager->GetBufferPool()) {
-                    buffer->~Buffer();
-                }
-                for (auto& renderer : renderers) {
-                    renderer.reset();
+                instanceBuffer.reset();
+                frameUniforms.reset();
+                secondaryRecorder.reset();
+                frameGraph.reset();
+                sceneMeshes.reset();
+                // Renderers may own buffers from the allocator.
+                if (pipelineLibrary) {
+                    pipelineLibrary->Stop();
                 }
                 renderers.clear();
+                pipelineLibrary.reset();
+                // Meshes held by the ECS can outlive the renderer, so their buffers are destroyed here while the
+                // device still exists instead of whenever the last reference goes away.
+                if (bufferManager) {
+                    bufferManager->DestroyAll();
+                }
+                mesh_pool.reset();
+                bufferManager.reset();
                 command_pool.reset();
                 swapchain.reset();
+                memoryAllocator.reset();
+                if (device) {
+                    device->GetPipelineCache().Save();
+                }
                 device.reset();
                 debugger.reset();
                 surface.reset();
@@ -61,25 +164,82 @@ namespace vkr {
                 window.reset();
             }
 
-            void SetRendererEntities(std::unordered_map<std::shared_ptr<vkr::Renderer>, std::vector<std::shared_ptr<ecs::Entity>>>& RendererEntities) {
-                for (auto& pair : RendererEntities) {
-                    bool found = false;
-                    for (auto& renderer : renderers) {
-                        if (auto derivedRenderer = std::dynamic_pointer_cast<decltype(pair.first)>(renderer)) {
-                            if (typeid(*derivedRenderer) == typeid(*pair.first)) {
-                                // Renderer found, do something
-                                found = true;
-                                break;
-                            }
-                        }
-                    }
-                    if (!found) {
-                        // Renderer not found, do something else
-                        auto renderer = pair.first;
-                        renderer.get()->GetEntities() = pair.second;
-                        renderers.push_back(renderer);
+            // Copies what the renderers need out of em into the next snapshot and hands it to the render loop.
+            // Called from the simulation side once per tick, never blocks on the frame being drawn.
+            void ExtractSnapshot(ecs::EntityManager& em) {
+                RenderSnapshot& snapshot = snapshots.GetWriteBuffer();
+                snapshot.Clear();
+                snapshot.frame = ++extractedFrames;
+
+                snapshot.viewProjection = qbn::mat<float, 4>{1};
+                for (auto [transform, camera] : em.View<const ecs::Transform3D, const ecs::Camera>()) {
+                    snapshot.viewProjection = camera.GetViewProjection(transform);
+                    break;
+                }
+
+                // Entities are drawn with their transform, every entity sharing a mesh in one instanced draw. Meshes
+                // still streaming in are left out until their upload has been handed to the graphics queue.
+                em.View<const ecs::Transform2D, const ecs::Mesh2D>().Each([this](const ecs::Transform2D& transform, const ecs::Mesh2D& mesh) {
+                    AddInstance(mesh.GetMesh(), {transform.GetModelMatrix(), mesh.GetColour()});
+                });
+                AddDraws(snapshot, snapshot.draws2D, nullptr);
+                em.View<const ecs::Transform3D, const ecs::Mesh3D>().Each([this](const ecs::Transform3D& transform, const ecs::Mesh3D& mesh) {
+                    AddInstance(mesh.GetMesh(), {transform.GetModelMatrix(), mesh.GetColour()});
+                });
+                AddDraws(snapshot, snapshot.draws3D, &snapshot.viewProjection);
+                AssignRevisions(snapshot);
+
+                snapshots.Publish();
+            }
+
+            // Records the renderers on every worker of jobs from now on, call after Init from the render thread.
+            void SetJobSystem(thm::JobSystem& jobs) {
+                secondaryRecorder = std::make_shared<SecondaryRecorder>(*device, static_cast<uint32_t>(swapchain->MAX_FRAMES_IN_FLIGHT), jobs);
+            }
+
+            void AddRenderer(std::shared_ptr<Renderer> renderer) {
+                for (auto& r : renderers) {
+                    if (typeid(*r) == typeid(*renderer)) {
+                        return;
                     }
                 }
+                renderers.push_back(renderer);
+            }
+
+            // Registers the 3D scene renderer. GPU culling needs compute on the graphics queue, without it the scene
+            // is drawn from the CPU instead.
+            void AddSceneRenderer(SceneCulling culling) {
+                if (culling != SceneCulling::Cpu && !device->HasGraphicsCompute()) {
+                    std::cout << "No compute on the graphics queue, culling on the CPU" << std::endl;
+                    culling = SceneCulling::Cpu;
+                }
+                if (culling == SceneCulling::Cpu) {
+                    AddRenderer(std::make_shared<TriangleRenderer3D>(device, swapchain, pipelineLibrary));
+                    std::cout << "Scene culling: cpu" << std::endl;
+                    return;
+                }
+
+                auto renderer = std::make_shared<CulledRenderer3D>(device, swapchain, pipelineLibrary, bufferManager, culling == SceneCulling::Gpu);
+                AddRenderer(renderer);
+                std::cout << "Scene culling: gpu, " << (renderer->UsesDrawIndirectCount() ? "indirect count" : device->HasMultiDrawIndirect() ? "multi draw indirect" : "one indirect draw per mesh") << std::endl;
+            }
+
+            // Wall time from Init to the end of the first frame drawn with every renderer's pipeline, 0 until then.
+            double GetTimeToFirstFrame() const {
+                return timeToFirstFrameMilliseconds;
+            }
+
+            const FrameStats& GetFrameStats() const {
+                return render->GetFrameStats();
+            }
+
+            // Switches present mode from the next frame, the swapchain is rebuilt without a stall.
+            void SetPresentMode(VkPresentModeKHR presentMode) {
+                swapchain->SetPresentMode(presentMode);
+            }
+
+            void SetLatePacing(bool latePacing) {
+                swapchain->GetPresentPolicy().latePacing = latePacing;
             }
 
             Window& GetWindow() {
@@ -94,15 +254,23 @@ namespace vkr {
                 return swapchain;
             }
 
+            std::shared_ptr<PipelineLibrary> GetPipelineLibrary() {
+                return pipelineLibrary;
+            }
+
             std::shared_ptr<BufferManager> GetBufferManager() {
                 return bufferManager;
             }
 
+            // Device memory usage per heap.
+            std::vector<MemoryAllocator::HeapStats> GetMemoryStats() {
+                return memoryAllocator->GetHeapStats();
+            }
+
             std::shared_ptr<MeshPool> GetMeshPool() {
                 return mesh_pool;
             }
 
-            std::mutex renderersMutex;
         private:
             std::shared_ptr<Window> window;
             std::shared_ptr<ValidationLayers> validationLayers;
@@ -110,12 +278,224 @@ namespace vkr {
             std::shared_ptr<Debugger> debugger;
             std::shared_ptr<Surface> surface;
             std::shared_ptr<Device> device;
+            std::shared_ptr<MemoryAllocator> memoryAllocator;
             std::shared_ptr<Swapchain> swapchain;
             std::shared_ptr<CommandPool> command_pool;
             std::shared_ptr<Render> render;
+            std::shared_ptr<PipelineLibrary> pipelineLibrary;
 
             std::vector<std::shared_ptr<vkr::Renderer>> renderers;
             std::shared_ptr<BufferManager> bufferManager;
             std::shared_ptr<MeshPool> mesh_pool;
+
+            thm::TripleBuffer<RenderSnapshot> snapshots;
+            uint64_t extractedFrames = 0;
+            // Extraction scratch, only touched from the simulation side.
+            InstanceBatcher batcher;
+            std::vector<std::shared_ptr<Mesh>> batchMeshes;
+            std::vector<std::pair<float, uint32_t>> depthOrder;
+            std::vector<InstanceData> sortedInstances;
+            // What the last extraction produced, for AssignRevisions. Holding the mesh keeps a new one from being
+            // allocated at the same address and passing for it.
+            struct PreviousDraw {
+                std::shared_ptr<Mesh> mesh;
+                uint32_t firstInstance;
+                uint32_t instanceCount;
+                uint64_t revision;
+            };
+            std::vector<PreviousDraw> previousDraws2D;
+            std::vector<PreviousDraw> previousDraws3D;
+            std::vector<InstanceData> previousInstances;
+            uint64_t revisionCounter = 0;
+            uint64_t sceneRevision = 0;
+            // Render side, the meshes of the snapshot revision last drawn.
+            std::shared_ptr<std::vector<std::shared_ptr<Mesh>>> sceneMeshes;
+            uint64_t sceneMeshesRevision = 0;
+            // Swapchain render pass the renderers' pipelines were last requested for.
+            uint64_t renderPassGeneration = 0;
+
+            std::shared_ptr<InstanceBuffer> instanceBuffer;
+            std::shared_ptr<UniformRing> frameUniforms;
+            FrameStatsAverage timing;
+
+            struct RecordTask {
+                Renderer* renderer;
+                uint32_t chunk;
+                uint32_t chunkCount;
+            };
+            std::shared_ptr<SecondaryRecorder> secondaryRecorder;
+
+            std::shared_ptr<RenderGraph> frameGraph;
+            RenderGraph::ResourceHandle swapchainImage = 0;
+            // The frame being recorded, for the graph's passes while Execute runs.
+            const RenderContext* frameContext = nullptr;
+            std::vector<RecordTask> recordTasks;
+
+            std::chrono::steady_clock::time_point initStart;
+            uint64_t renderedFrames = 0;
+            double timeToFirstFrameMilliseconds = 0.0;
+
+            void AddInstance(const std::shared_ptr<Mesh>& mesh, const InstanceData& instance) {
+                if (!mesh->IsResident()) {
+                    return;
+                }
+                if (batcher.Add(mesh.get(), instance) == batchMeshes.size()) {
+                    batchMeshes.push_back(mesh);
+                }
+            }
+
+            // The frame as a render graph. Renderers prepare first, outside any render pass, synchronising their
+            // own compute work. Then the swapchain pass runs, with the graph moving the image into the attachment
+            // layout after acquire and on to present afterwards. Further passes declare what they use here and get
+            // their barriers, culling and transient memory from the graph. Compiled once, the swapchain image is the
+            // only thing that changes between frames.
+            void BuildFrameGraph() {
+                frameGraph->Clear();
+                swapchainImage = frameGraph->ImportImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_UNDEFINED, ResourceUsage::Present);
+                frameGraph->AddPass("prepare", [this](VkCommandBuffer commandBuffer) {
+                    for (auto& renderer : renderers) {
+                        renderer->Prepare(*frameContext);
+                    }
+                }).SideEffects();
+                frameGraph->AddPass("swapchain", [this](VkCommandBuffer commandBuffer) {
+                    RecordSwapchainPass(*frameContext);
+                }).Write(swapchainImage, ResourceUsage::ColourAttachment);
+                frameGraph->Compile();
+            }
+
+            void RecordSwapchainPass(const RenderContext& context) {
+                if (secondaryRecorder) {
+                    render->BeginSwapchainRenderpass(context.commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                    RecordParallel(context);
+                }
+                else {
+                    render->BeginSwapchainRenderpass(context.commandBuffer);
+                    for (auto& renderer : renderers) {
+                        renderer->Render(context);
+                    }
+                }
+                render->EndSwapchainRenderpass(context.commandBuffer);
+            }
+
+            // Every chunk of every renderer becomes a task in renderer order, so the secondaries execute in the same
+            // order the renderers would have recorded inline.
+            void RecordParallel(const RenderContext& context) {
+                secondaryRecorder->BeginFrame(context.frameIndex);
+                recordTasks.clear();
+                for (auto& renderer : renderers) {
+                    uint32_t chunkCount = renderer->GetChunkCount(context);
+                    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                        recordTasks.push_back({renderer.get(), chunk, chunkCount});
+                    }
+                }
+                VkFramebuffer framebuffer = swapchain->GetFramebuffer(swapchain->GetCurrentImageIndex());
+                auto key = [&](size_t t) {
+                    return recordTasks[t].renderer->GetChunkKey(context, recordTasks[t].chunk, recordTasks[t].chunkCount);
+                };
+                secondaryRecorder->Record(context.commandBuffer, context.frameIndex, swapchain->GetRenderPass(), swapchain->GetRenderPassGeneration(), framebuffer, swapchain->GetExtent(), recordTasks.size(), key, [&](VkCommandBuffer commandBuffer, size_t t) {
+                    RenderContext chunkContext{commandBuffer, context.frameIndex, context.snapshot, context.instanceBuffer, context.instanceGeneration, context.frameSet, context.cameraOffset};
+                    recordTasks[t].renderer->RenderChunk(chunkContext, recordTasks[t].chunk, recordTasks[t].chunkCount);
+                });
+            }
+
+            // Averages over the policy's report interval, so present modes, frames in flight and pacing can be
+            // compared on frame time (throughput) against input to submit time (latency).
+            void ReportTiming() {
+                const PresentPolicy& policy = swapchain->GetPresentPolicy();
+                if (policy.timingReportInterval == 0) {
+                    return;
+                }
+                timing.Add(render->GetFrameStats());
+                if (timing.count < policy.timingReportInterval) {
+                    return;
+                }
+                FrameStats average = timing.Get();
+                std::cout << PresentModeName(swapchain->GetPresentMode()) << ", " << swapchain->MAX_FRAMES_IN_FLIGHT << " in flight" << (policy.latePacing ? ", late pacing" : "")
+                    << ": frame " << average.frameMilliseconds << " ms, cpu " << average.cpuMilliseconds << " ms, gpu " << average.gpuMilliseconds
+                    << " ms, fence wait " << average.fenceWaitMilliseconds << " ms, input to submit " << average.inputToSubmitMilliseconds << " ms" << std::endl;
+                timing.Reset();
+            }
+
+            // One instanced draw per mesh the batcher saw, its instances appended to the snapshot's. With a
+            // viewProjection the draws are opaque 3D and ordered front to back, instances within each draw too, so
+            // early depth testing rejects as much hidden work as possible.
+            void AddDraws(RenderSnapshot& snapshot, std::vector<RenderSnapshot::Draw>& draws, const qbn::mat<float, 4>* viewProjection) {
+                auto& batches = batcher.Build(snapshot.instances);
+                for (size_t b = 0; b < batches.size(); b++) {
+                    auto& mesh = batchMeshes[b];
+                    const MeshRange& range = mesh->GetRange();
+                    float depth = viewProjection ? SortFrontToBack(snapshot.instances, batches[b].firstInstance, batches[b].instanceCount, *viewProjection) : 0.0f;
+                    draws.push_back({mesh, mesh->GetVertexBuffer()->GetBuffer(), mesh->GetIndexBuffer()->GetBuffer(), range.indexType, range.firstIndex, range.indexCount, static_cast<int32_t>(range.firstVertex), batches[b].firstInstance, batches[b].instanceCount, depth, 0});
+                }
+                SortDraws(draws);
+
+                batcher.Clear();
+                batchMeshes.clear();
+            }
+
+            // A draw keeps the revision of the draw in the same place last extraction if it has the same mesh and
+            // byte for byte the same instances, anything else gets a new one. Comparing is a memcmp per draw on the
+            // simulation side, far cheaper than recording the draw again on the render side.
+            void AssignRevisions(RenderSnapshot& snapshot) {
+                bool changed = snapshot.draws2D.size() != previousDraws2D.size() || snapshot.draws3D.size() != previousDraws3D.size();
+                changed |= AssignRevisions(snapshot, snapshot.draws2D, previousDraws2D);
+                changed |= AssignRevisions(snapshot, snapshot.draws3D, previousDraws3D);
+                if (changed || sceneRevision == 0) {
+                    sceneRevision = ++revisionCounter;
+                }
+                snapshot.revision = sceneRevision;
+                previousInstances = snapshot.instances;
+            }
+
+            bool AssignRevisions(const RenderSnapshot& snapshot, std::vector<RenderSnapshot::Draw>& draws, std::vector<PreviousDraw>& previous) {
+                bool changed = false;
+                for (size_t i = 0; i < draws.size(); i++) {
+                    auto& draw = draws[i];
+                    bool same = i < previous.size() && previous[i].mesh == draw.mesh && previous[i].firstInstance == draw.firstInstance && previous[i].instanceCount == draw.instanceCount
+                        && memcmp(snapshot.instances.data() + draw.firstInstance, previousInstances.data() + draw.firstInstance, sizeof(InstanceData) * draw.instanceCount) == 0;
+                    draw.revision = same ? previous[i].revision : ++revisionCounter;
+                    changed |= !same;
+                }
+                previous.resize(draws.size());
+                for (size_t i = 0; i < draws.size(); i++) {
+                    previous[i] = {draws[i].mesh, draws[i].firstInstance, draws[i].instanceCount, draws[i].revision};
+                }
+                return changed;
+            }
+
+            // Sorts count instances from first by the clip space depth of their origin and returns the nearest.
+            float SortFrontToBack(std::vector<InstanceData>& instances, uint32_t first, uint32_t count, const qbn::mat<float, 4>& viewProjection) {
+                depthOrder.clear();
+                for (uint32_t i = 0; i < count; i++) {
+                    depthOrder.push_back({ClipDepth(viewProjection, instances[first + i].model), first + i});
+                }
+                std::sort(depthOrder.begin(), depthOrder.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                sortedInstances.clear();
+                for (auto& [depth, index] : depthOrder) {
+                    sortedInstances.push_back(instances[index]);
+                }
+                std::copy(sortedInstances.begin(), sortedInstances.end(), instances.begin() + first);
+                return depthOrder.empty() ? 0.0f : depthOrder.front().first;
+            }
+
+            // z / w of the model's origin, instances behind the camera sort last.
+            static float ClipDepth(const qbn::mat<float, 4>& viewProjection, const qbn::mat<float, 4>& model) {
+                float x = model[3][0], y = model[3][1], z = model[3][2];
+                float clipZ = viewProjection[0][2] * x + viewProjection[1][2] * y + viewProjection[2][2] * z + viewProjection[3][2];
+                float clipW = viewProjection[0][3] * x + viewProjection[1][3] * y + viewProjection[2][3] * z + viewProjection[3][3];
+                if (clipW <= 0.0f) {
+                    return std::numeric_limits<float>::max();
+                }
+                return clipZ / clipW;
+            }
+
+            // Groups draws sharing an arena page so the renderers only rebind buffers between pages, nearest first
+            // within a page.
+            static void SortDraws(std::vector<RenderSnapshot::Draw>& draws) {
+                std::sort(draws.begin(), draws.end(), [](const RenderSnapshot::Draw& a, const RenderSnapshot::Draw& b) {
+                    return std::tie(a.vertexBuffer, a.indexBuffer, a.depth, a.firstIndex) < std::tie(b.vertexBuffer, b.indexBuffer, b.depth, b.firstIndex);
+                });
+            }
     };
 }
\ No newline at end of file